@@ -1,110 +1,1108 @@
 #include <opencv2/opencv.hpp>
-#include <opencv2/face.hpp>
-#include <iostream>
 #include <vector>
 #include <filesystem> 
 #include <string>
+#include <memory>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <shared_mutex>
+#include <set>
+#include <thread>
+#include <csignal>
+#include <cfloat>
 #include "external/mongoose.h"
+#include "ann_index.hpp"
+#include "async_log.hpp"
+#include "async_reply.hpp"
+#include "face_tracker.hpp"
+#include "image_input.hpp"
+#include "gallery_loader.hpp"
+#include "lbph_matcher.hpp"
+#include "model_snapshot.hpp"
+#include "result_cache.hpp"
+#include "server_metrics.hpp"
+#include "chisqr.hpp"
+#include "server_env.hpp"
+#include "worker_pool.hpp"
 
 namespace fs = std::filesystem;  
 using namespace cv;
-using namespace cv::face;
 using namespace std;
 
-// Singleton pour le modèle de reconnaissance
-Ptr<LBPHFaceRecognizer> model = LBPHFaceRecognizer::create();
+// Modèle courant (paramètres LBPH par défaut : rayon 1, 8 voisins, grille 8x8).
+// Compté par références : une requête garde le sien jusqu'au bout, /reload
+// en construit un autre à côté et le remplace d'un coup (atomic_store).
+static shared_ptr<LbphMatcher> model;
+// Identifications en parallèle (verrou partagé), /enroll et /remove exclusifs
+static shared_mutex model_mutex;
+
+static shared_ptr<LbphMatcher> current_model() {
+    return atomic_load(&model);
+}
+
+// Dossier des visages et instantané associé (fixés dans main)
+static string gallery_dir;
+static string snapshot_file;
+
+// Etat de l'instantané sur disque (voir schedule_snapshot_save), sous
+// snapshot_write_mutex : empreinte de l'instantané, modifications ajoutées
+// à son journal depuis. journal_ready faux : la prochaine écriture
+// réécrit l'instantané complet.
+static mutex snapshot_write_mutex;
+static bool journal_ready = false;
+static uint64_t journal_base = 0;
+static size_t journal_count = 0;
+
+// Mode shard (FACE_SHARD=i/n) : cette instance ne possède que les labels
+// tels que label % n == i ; shard_router répartit les requêtes.
+static int shard_index = 0;
+static int shard_count = 1;
+
+static bool owns_label(int label) {
+    return label % shard_count == shard_index;
+}
+
+// Empreinte du dossier attendue dans l'instantané de cette instance : le
+// shard y est mêlé, pour l'écriture comme pour la lecture.
+static uint64_t gallery_fingerprint(const string& directory_path) {
+    return directory_fingerprint(directory_path,
+        shard_count > 1 ? "shard=" + to_string(shard_index) + "/" + to_string(shard_count) : "");
+}
 
 /**
- * Charge automatiquement toutes les images du dossier clients.
+ * Charge automatiquement toutes les images du dossier clients dans `target`.
  * Format attendu : "ID.jpg" ou "ID.png" (ex: 1.jpg, 2.jpg)
+ * Le modèle est repris de l'instantané `snapshot_path` s'il est à jour,
+ * sinon réentraîné sur `threads` threads puis sauvegardé ; chemin vide
+ * (/reload) : toujours réentraîné, rien n'est écrit.
+ * `files` reçoit les fichiers parcourus (vide si l'instantané a servi).
+ * Retourne false si aucune image n'a pu être chargée.
  */
-void train_model(const string& directory_path) {
-    vector<Mat> images;
-    vector<int> labels;
+static bool train_model(LbphMatcher& target, const string& directory_path, const string& snapshot_path,
+                        size_t threads, vector<GalleryFile>& files) {
+    // Démarrage rapide : instantané valide tant que le dossier n'a pas changé
+    uint64_t fingerprint = gallery_fingerprint(directory_path);
+    if (!snapshot_path.empty()) {
+        string reason;
+        size_t edits = 0;
+        if (load_snapshot(snapshot_path, target, fingerprint, reason, &edits)) {
+            log_info("[OK] Modèle chargé depuis %s (%zu images dont %zu modification(s) du journal, noyau chi2 : %s).",
+                     snapshot_path.c_str(), target.size(), edits, chisqr_kernel_name());
+            // Journal non vide : compacté à la prochaine modification
+            lock_guard<mutex> lock(snapshot_write_mutex);
+            journal_ready = edits == 0;
+            journal_base = fingerprint;
+            journal_count = 0;
+            return true;
+        }
+        log_info("[INFO] Instantané %s ignoré (%s).", snapshot_path.c_str(), reason.c_str());
+    }
 
-    cout << "[INFO] Entraînement du modèle en cours..." << endl;
+    log_info("[INFO] Entraînement du modèle en cours...");
 
     try {
-        for (const auto& entry : fs::directory_iterator(directory_path)) {
-            string path = entry.path().string();
-            string filename = entry.path().stem().string(); // Récupère le nom sans extension
-
-            // Convertir le nom du fichier en ID entier
-            try {
-                int label = stoi(filename);
-                Mat img = imread(path, IMREAD_GRAYSCALE);
-
-                if (!img.empty()) {
-                    images.push_back(img);
-                    labels.push_back(label);
-                    cout << "  > Chargé : Client " << label << " (" << path << ")" << endl;
-                }
-            } catch (const exception& e) {
-                cerr << "  [!] Ignoré : " << path << " (le nom doit être un nombre ID)" << endl;
+        // Décodage + extraction répartis sur `threads` coeurs
+        files = load_gallery(directory_path, target, threads, nullptr,
+                             shard_count > 1 ? LabelFilter(owns_label) : nullptr);
+        for (const auto& f : files) {
+            if (f.status == GalleryFile::LOADED) {
+                log_debug("  > Chargé : Client %d (%s)", f.label, f.path.c_str());
+            } else if (f.status == GalleryFile::BAD_NAME) {
+                log_warn("  [!] Ignoré : %s (le nom doit être un nombre ID)", f.path.c_str());
             }
         }
 
-        if (images.empty()) {
-            cerr << "[ERREUR] Aucune image trouvée dans " << directory_path << endl;
-            return;
+        if (target.empty()) {
+            log_error("[ERREUR] Aucune image trouvée dans %s", directory_path.c_str());
+            return false;
         }
 
-        model->train(images, labels);
-        cout << "[OK] Modèle entraîné avec " << images.size() << " images." << endl;
+        log_info("[OK] Modèle entraîné avec %zu images (noyau chi2 : %s).", target.size(), chisqr_kernel_name());
+
+        if (snapshot_path.empty()) return true;
+        bool saved = save_snapshot(snapshot_path, target, fingerprint);
+        if (saved) {
+            log_info("[OK] Instantané écrit : %s", snapshot_path.c_str());
+        } else {
+            log_warn("[!] Impossible d'écrire l'instantané %s", snapshot_path.c_str());
+        }
+        lock_guard<mutex> lock(snapshot_write_mutex);
+        journal_ready = saved;
+        journal_base = fingerprint;
+        journal_count = 0;
+        return true;
     } catch (const exception& e) {
-        cerr << "[ERREUR FATALE] Impossible d'accéder au dossier : " << e.what() << endl;
+        log_error("[ERREUR FATALE] Impossible d'accéder au dossier : %s", e.what());
+        return false;
+    }
+}
+
+// Réglages repris par chaque modèle construit (démarrage et /reload)
+static AnnParams ann_params;
+static shared_ptr<WorkerPool> search_pool;
+static size_t parallel_min_rows = 0;
+
+// Index approché (construit sur `threads` threads, comme l'entraînement)
+// et recherche parallèle d'un modèle fraîchement entraîné
+static void finish_model(LbphMatcher& m, size_t threads) {
+    if (m.build_index(ann_params, threads)) {
+        log_info("[OK] Index approché : %zu listes (probes %zu, rerank %zu).", m.index()->lists(),
+                 ann_params.probes, ann_params.rerank);
+    }
+    if (search_pool) m.set_parallel_search(search_pool, parallel_min_rows);
+}
+
+// Boucle d'événements et pool partagés avec les workers (mg_wakeup)
+static struct mg_mgr mgr;
+static unique_ptr<WorkerPool> pool;
+
+// Seuil de confiance LBPH (A ajuster selon l'éclairage)
+static const double CONFIDENCE_THRESHOLD = 100.0;
+
+// Résultats récents, inconnus compris (FACE_CACHE_SIZE, FACE_CACHE_TTL_MS, FACE_CACHE_HAMMING)
+static unique_ptr<ResultCache> cache;
+
+// Compteurs et latences exposés par /metrics (indices de route fixés dans main)
+static unique_ptr<ServerMetrics> metrics;
+static size_t ep_identify, ep_identify_batch, ep_identify_frame, ep_verify;
+
+// Distance au format JSON : null sans aucune image comparée (galerie ou
+// shard vide), où la distance vaut DBL_MAX (plus de 300 chiffres en %.2f)
+static string confidence_json(double confidence) {
+    if (confidence >= DBL_MAX) return "null";
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%.2f", confidence);
+    return buf;
+}
+
+// Issue d'une identification pour /metrics
+static Outcome outcome_of(int label, double confidence) {
+    return label != -1 && confidence < CONFIDENCE_THRESHOLD ? OUTCOME_MATCH : OUTCOME_UNKNOWN;
+}
+
+/**
+ * Le même visage arrive plusieurs fois par seconde : une image presque
+ * identique à une image récente reprend son résultat sans recherche 1:N.
+ * Extraction hors verrou, seule la recherche tient le verrou partagé.
+ * Hachage et extraction comptent en prétraitement, la recherche en predict.
+ */
+static void predict_face(const Mat& face, int& label, double& confidence, StageTimes& times) {
+    Stopwatch watch;
+    PHash key = perceptual_hash(face);
+    uint64_t generation = cache->generation();
+    bool cached = cache->lookup(key, label, confidence);
+    if (cached) {
+        times.add(STAGE_PREPROCESS, watch.lap());
+        return;
+    }
+
+    // Modèle lu après la génération du cache : un résultat de l'ancien
+    // modèle n'est pas mis en cache après un /reload
+    shared_ptr<LbphMatcher> m = current_model();
+    AlignedFloats query;
+    label = -1;
+    confidence = 0.0;
+    bool usable = m->extract(face, query);
+    times.add(STAGE_PREPROCESS, watch.lap());
+    if (!usable) return;
+
+    {
+        shared_lock<shared_mutex> lock(model_mutex);
+        m->nearest(query.data(), label, confidence);
+    }
+    times.add(STAGE_PREDICT, watch.lap());
+    cache->insert(key, label, confidence, generation);
+}
+
+/**
+ * Version lot de predict_face() : les visages absents du cache sont
+ * cherchés ensemble (nearest_batch), la galerie n'est lue qu'une fois.
+ */
+static void predict_faces(const vector<Mat>& faces, vector<int>& labels, vector<double>& confidences,
+                          StageTimes& times) {
+    Stopwatch watch;
+    labels.assign(faces.size(), -1);
+    confidences.assign(faces.size(), 0.0);
+    uint64_t generation = cache->generation();
+    shared_ptr<LbphMatcher> m = current_model();
+
+    vector<PHash> keys(faces.size());
+    vector<AlignedFloats> queries;
+    vector<size_t> slots;
+    for (size_t i = 0; i < faces.size(); i++) {
+        keys[i] = perceptual_hash(faces[i]);
+        if (cache->lookup(keys[i], labels[i], confidences[i])) continue;
+        queries.emplace_back();
+        if (!m->extract(faces[i], queries.back())) {
+            queries.pop_back();
+            continue;
+        }
+        slots.push_back(i);
+    }
+    times.add(STAGE_PREPROCESS, watch.lap());
+    if (slots.empty()) return;
+
+    vector<const float*> pointers;
+    for (const AlignedFloats& q : queries) pointers.push_back(q.data());
+    vector<int> found;
+    vector<double> distances;
+    {
+        shared_lock<shared_mutex> lock(model_mutex);
+        m->nearest_batch(pointers, found, distances);
+    }
+    times.add(STAGE_PREDICT, watch.lap());
+    for (size_t k = 0; k < slots.size(); k++) {
+        labels[slots[k]] = found[k];
+        confidences[slots[k]] = distances[k];
+        cache->insert(keys[slots[k]], found[k], distances[k], generation);
+    }
+}
+
+/**
+ * Identification exécutée sur un worker : décodage + predict, puis la
+ * réponse est renvoyée à la boucle mongoose via mg_wakeup().
+ * Avec `timing` (?timing=1), la réponse porte un en-tête Server-Timing
+ * (décodage, prétraitement, recherche, en ms).
+ */
+static void identify_job(unsigned long conn_id, const ImageRequest& req, bool timing) {
+    StageTimes times;
+    Stopwatch watch;
+    Mat test_img = decode_image_request(req);
+    times.add(STAGE_DECODE, watch.lap());
+    if (test_img.empty()) {
+        metrics->count(ep_identify, OUTCOME_ERROR);
+        metrics->observe(times);
+        async_reply(&mgr, conn_id, 400, "", "{\"error\": \"Image invalide\"}");
+        return;
+    }
+
+    int label = -1;
+    double confidence = 0.0;
+    predict_face(test_img, label, confidence, times);
+
+    log_info("[LOG] Identification - ID: %d | Confiance: %g", label, confidence);
+
+    // La distance permet à shard_router de retenir le meilleur shard
+    watch.lap();
+    string headers = "Content-Type: application/json\r\n";
+    if (timing) headers += server_timing_header(times);
+    if (label != -1 && confidence < CONFIDENCE_THRESHOLD) {
+        async_reply(&mgr, conn_id, 200, headers.c_str(),
+                    "{\"client_id\": %d, \"confidence\": %.2f}", label, confidence);
+    } else {
+        async_reply(&mgr, conn_id, 200, headers.c_str(),
+                    "{\"client_id\": null, \"confidence\": %s}", confidence_json(confidence).c_str());
+    }
+    times.add(STAGE_REPLY, watch.lap());
+    metrics->count(ep_identify, outcome_of(label, confidence));
+    metrics->observe(times);
+}
+
+/**
+ * Identification d'un lot de visages (plusieurs clients dans le champ).
+ * Un seul job pour tout le lot : une connexion, un parsing, un passage
+ * dans la file. Réponse : tableau JSON dans l'ordre des images reçues.
+ */
+static void identify_batch_job(unsigned long conn_id, const vector<ImageRequest>& reqs) {
+    StageTimes times;
+    Stopwatch watch;
+    vector<Mat> faces(reqs.size());
+    for (size_t i = 0; i < reqs.size(); i++) faces[i] = decode_image_request(reqs[i]);
+    times.add(STAGE_DECODE, watch.lap());
+
+    vector<Mat> valid;
+    for (const Mat& face : faces) {
+        if (!face.empty()) valid.push_back(face);
+    }
+    vector<int> labels;
+    vector<double> confidences;
+    predict_faces(valid, labels, confidences, times);
+
+    watch.lap();
+    string json = "[";
+    for (size_t i = 0, k = 0; i < reqs.size(); i++) {
+        if (i > 0) json += ", ";
+        if (faces[i].empty()) {
+            metrics->count(ep_identify_batch, OUTCOME_ERROR);
+            json += "{\"client_id\": null, \"error\": \"Image invalide\"}";
+            continue;
+        }
+
+        int label = labels[k];
+        double confidence = confidences[k++];
+        metrics->count(ep_identify_batch, outcome_of(label, confidence));
+        char item[96];
+        if (label != -1 && confidence < CONFIDENCE_THRESHOLD) {
+            snprintf(item, sizeof(item), "{\"client_id\": %d, \"confidence\": %.2f}", label, confidence);
+        } else {
+            snprintf(item, sizeof(item), "{\"client_id\": null, \"confidence\": %s}",
+                     confidence_json(confidence).c_str());
+        }
+        json += item;
+    }
+    json += "]";
+
+    log_info("[LOG] Identification lot - %zu visage(s)", reqs.size());
+    async_reply(&mgr, conn_id, 200, "Content-Type: application/json\r\n", "%s", json.c_str());
+    times.add(STAGE_REPLY, watch.lap());
+    metrics->observe(times);
+}
+
+// Détection côté serveur : mêmes réglages que l'orchestrateur Python
+static const double DETECT_SCALE_FACTOR = 1.3;
+static const int DETECT_MIN_NEIGHBORS = 5;
+static const Size FACE_SIZE(200, 200);
+static string cascade_path;
+
+// Mode suivi (?stream=) : identités réutilisées d'une image à l'autre (FACE_TRACK_*)
+static unique_ptr<FaceTracker> tracker;
+
+// CascadeClassifier n'est pas thread-safe : une instance par worker, chargée au premier usage.
+static CascadeClassifier* worker_cascade() {
+    thread_local CascadeClassifier cascade;
+    thread_local bool loaded = false;
+    if (!loaded) loaded = cascade.load(cascade_path);
+    return loaded ? &cascade : NULL;
+}
+
+/**
+ * Image caméra complète : détection, recadrage, 200x200 et identification
+ * de chaque visage en un seul appel natif.
+ * Avec un flux (`stream` non vide), un visage déjà suivi reprend l'identité
+ * de sa piste au lieu d'être réidentifié ; "track_id" est ajouté.
+ * Réponse : {"faces": [{"x", "y", "w", "h", "client_id", "confidence"}, ...]}
+ */
+static void identify_frame_job(unsigned long conn_id, const ImageRequest& req, const string& stream) {
+    StageTimes times;
+    Stopwatch watch;
+    Mat frame = decode_image_request(req);
+    times.add(STAGE_DECODE, watch.lap());
+    if (frame.empty()) {
+        metrics->count(ep_identify_frame, OUTCOME_ERROR);
+        metrics->observe(times);
+        async_reply(&mgr, conn_id, 400, "", "{\"error\": \"Image invalide\"}");
+        return;
+    }
+
+    CascadeClassifier* cascade = worker_cascade();
+    if (cascade == NULL) {
+        times.add(STAGE_PREPROCESS, watch.lap());
+        metrics->count(ep_identify_frame, OUTCOME_ERROR);
+        metrics->observe(times);
+        async_reply(&mgr, conn_id, 500, "", "{\"error\": \"Classifieur introuvable\"}");
+        return;
+    }
+
+    vector<Rect> boxes;
+    cascade->detectMultiScale(frame, boxes, DETECT_SCALE_FACTOR, DETECT_MIN_NEIGHBORS);
+
+    vector<FaceTracker::Match> tracks;
+    if (!stream.empty()) tracks = tracker->associate(stream, boxes);
+
+    // Visages à identifier (nouveaux ou incertains) : une seule recherche en lot
+    vector<int> labels(boxes.size(), -1);
+    vector<double> confidences(boxes.size(), 0.0);
+    vector<Mat> faces;
+    vector<size_t> slots;
+    for (size_t i = 0; i < boxes.size(); i++) {
+        if (tracks.empty() || tracks[i].identify) {
+            faces.emplace_back();
+            resize(frame(boxes[i]), faces.back(), FACE_SIZE);
+            slots.push_back(i);
+        } else {
+            labels[i] = tracks[i].label;
+            confidences[i] = tracks[i].confidence;
+        }
+    }
+    // Détection et recadrage comptent en prétraitement
+    times.add(STAGE_PREPROCESS, watch.lap());
+    vector<int> found;
+    vector<double> distances;
+    predict_faces(faces, found, distances, times);
+    watch.lap();
+    for (size_t k = 0; k < slots.size(); k++) {
+        size_t i = slots[k];
+        labels[i] = found[k];
+        confidences[i] = distances[k];
+        if (!tracks.empty()) tracker->update(stream, tracks[i].track_id, labels[i], confidences[i]);
+    }
+
+    string json = "{\"faces\": [";
+    for (size_t i = 0; i < boxes.size(); i++) {
+        const Rect& r = boxes[i];
+        int label = labels[i];
+        double confidence = confidences[i];
+        metrics->count(ep_identify_frame, outcome_of(label, confidence));
+
+        if (!tracks.empty()) {
+            char id[32];
+            snprintf(id, sizeof(id), "%s{\"track_id\": %d, ", i > 0 ? ", " : "", tracks[i].track_id);
+            json += id;
+        } else {
+            json += i > 0 ? ", {" : "{";
+        }
+
+        char item[160];
+        if (label != -1 && confidence < CONFIDENCE_THRESHOLD) {
+            snprintf(item, sizeof(item),
+                     "\"x\": %d, \"y\": %d, \"w\": %d, \"h\": %d, \"client_id\": %d, \"confidence\": %.2f}",
+                     r.x, r.y, r.width, r.height, label, confidence);
+        } else {
+            snprintf(item, sizeof(item),
+                     "\"x\": %d, \"y\": %d, \"w\": %d, \"h\": %d, \"client_id\": null, \"confidence\": %s}",
+                     r.x, r.y, r.width, r.height, confidence_json(confidence).c_str());
+        }
+        json += item;
+    }
+    json += "]}";
+
+    async_reply(&mgr, conn_id, 200, "Content-Type: application/json\r\n", "%s", json.c_str());
+    times.add(STAGE_REPLY, watch.lap());
+    metrics->observe(times);
+}
+
+// Label d'un fichier de la galerie : "12.jpg", "12_1718000000.png" -> 12 (comme train_model)
+static bool label_of_file(const fs::path& file, int& label) {
+    try {
+        label = stoi(file.stem().string());
+        return true;
+    } catch (const exception&) {
+        return false;
+    }
+}
+
+static atomic<bool> snapshot_pending(false);
+
+// /enroll et /remove reçus pendant un /reload (sous model_mutex), rejoués
+// sur le nouveau modèle avant l'échange. hist vide : suppression.
+struct GalleryEdit {
+    int label;
+    AlignedFloats hist;
+    string file;
+};
+static bool reload_running = false;
+static vector<GalleryEdit> reload_edits;
+
+// /enroll et /remove pas encore écrits dans le journal, dans l'ordre où ils
+// ont modifié le modèle (ajoutés sous le verrou exclusif)
+static mutex journal_queue_mutex;
+static vector<JournalEdit> journal_queue;
+
+// Taille du journal au-delà de laquelle l'instantané est réécrit : au moins
+// JOURNAL_MIN_EDITS, sinon la moitié de la galerie (coût amorti constant).
+static const size_t JOURNAL_MIN_EDITS = 64;
+
+static void queue_journal_edit(int label, const float* hist, size_t dim) {
+    lock_guard<mutex> lock(journal_queue_mutex);
+    journal_queue.push_back({label, hist ? vector<float>(hist, hist + dim) : vector<float>()});
+}
+
+// Réécrit l'instantané complet et vide le journal (sous snapshot_write_mutex).
+// Tient le verrou partagé pendant l'écriture : rare, voir JOURNAL_MIN_EDITS.
+static void compact_snapshot() {
+    shared_ptr<LbphMatcher> m = current_model();
+    shared_lock<shared_mutex> lock(model_mutex);
+    {
+        // Tout ce qui attend est déjà dans le modèle écrit
+        lock_guard<mutex> queue_lock(journal_queue_mutex);
+        journal_queue.clear();
+    }
+    uint64_t fingerprint = gallery_fingerprint(gallery_dir);
+    journal_ready = save_snapshot(snapshot_file, *m, fingerprint);
+    journal_base = fingerprint;
+    journal_count = 0;
+    if (!journal_ready) log_warn("[!] Impossible d'écrire l'instantané %s", snapshot_file.c_str());
+}
+
+/**
+ * Met l'instantané à jour après /enroll, /remove ou /reload, sur un worker.
+ * Les modifications rapprochées sont regroupées en une seule écriture.
+ *
+ * Une modification n'ajoute qu'un enregistrement au journal de l'instantané
+ * (un histogramme, pas toute la galerie) ; l'instantané n'est réécrit qu'au
+ * compactage : journal trop long, après /reload, ou journal inutilisable.
+ * Le verrou partagé couvre seulement la prise de la file et l'empreinte du
+ * dossier (cohérentes : /enroll écrit son image sous le verrou exclusif).
+ */
+static void schedule_snapshot_save() {
+    if (snapshot_pending.exchange(true)) return;
+    pool->submit([]() {
+        lock_guard<mutex> write_lock(snapshot_write_mutex);
+        snapshot_pending = false;
+        shared_ptr<LbphMatcher> m = current_model();
+        vector<JournalEdit> edits;
+        uint64_t fingerprint;
+        size_t gallery_size;
+        {
+            shared_lock<shared_mutex> lock(model_mutex);
+            lock_guard<mutex> queue_lock(journal_queue_mutex);
+            edits.swap(journal_queue);
+            fingerprint = gallery_fingerprint(gallery_dir);
+            gallery_size = m->size();
+        }
+        if (journal_ready && edits.empty()) return;
+
+        if (journal_ready && journal_count + edits.size() <= max(JOURNAL_MIN_EDITS, gallery_size / 2) &&
+            append_journal(snapshot_file, m->dim(), journal_base, edits, fingerprint)) {
+            journal_count += edits.size();
+            return;
+        }
+        compact_snapshot();
+    });
+}
+
+// Après /reload : le prochain schedule_snapshot_save() réécrit tout.
+static void invalidate_journal() {
+    lock_guard<mutex> lock(snapshot_write_mutex);
+    journal_ready = false;
+}
+
+/**
+ * Vérification 1:1 (paiement : l'empreinte désigne déjà le client) : le
+ * visage n'est comparé qu'aux images de ce client, pas à toute la galerie.
+ * Réponse : {"client_id", "match", "confidence"} ; 404 si le client n'a
+ * aucune image.
+ */
+static void verify_job(unsigned long conn_id, int label, const ImageRequest& req) {
+    StageTimes times;
+    Stopwatch watch;
+    Mat face = decode_image_request(req);
+    times.add(STAGE_DECODE, watch.lap());
+    if (face.empty()) {
+        metrics->count(ep_verify, OUTCOME_ERROR);
+        metrics->observe(times);
+        async_reply(&mgr, conn_id, 400, "", "{\"error\": \"Image invalide\"}");
+        return;
+    }
+
+    shared_ptr<LbphMatcher> m = current_model();
+    AlignedFloats query;
+    bool usable = m->extract(face, query);
+    times.add(STAGE_PREPROCESS, watch.lap());
+    if (!usable) {
+        metrics->count(ep_verify, OUTCOME_ERROR);
+        metrics->observe(times);
+        async_reply(&mgr, conn_id, 400, "", "{\"error\": \"Image trop petite\"}");
+        return;
+    }
+
+    double confidence;
+    bool known;
+    {
+        shared_lock<shared_mutex> lock(model_mutex);
+        known = m->nearest_in_label(query.data(), label, confidence);
+    }
+    times.add(STAGE_PREDICT, watch.lap());
+    if (!known) {
+        metrics->count(ep_verify, OUTCOME_ERROR);
+        metrics->observe(times);
+        async_reply(&mgr, conn_id, 404, "", "{\"error\": \"Client sans image\"}");
+        return;
+    }
+
+    bool match = confidence < CONFIDENCE_THRESHOLD;
+    log_info("[LOG] Vérification - ID: %d | Confiance: %g | %s", label, confidence, match ? "OK" : "REFUSE");
+    watch.lap();
+    async_reply(&mgr, conn_id, 200, "Content-Type: application/json\r\n",
+                "{\"client_id\": %d, \"match\": %s, \"confidence\": %.2f}", label,
+                match ? "true" : "false", confidence);
+    times.add(STAGE_REPLY, watch.lap());
+    metrics->count(ep_verify, match ? OUTCOME_MATCH : OUTCOME_UNKNOWN);
+    metrics->observe(times);
+}
+
+/**
+ * Ajoute un visage à la galerie sans réentraînement : une seule extraction.
+ * L'image est aussi enregistrée dans le dossier clients (sauf si elle y est
+ * déjà) pour survivre à un redémarrage.
+ */
+static void enroll_job(unsigned long conn_id, int label, const ImageRequest& req) {
+    Mat face = decode_image_request(req);
+    if (face.empty()) {
+        async_reply(&mgr, conn_id, 400, "", "{\"error\": \"Image invalide\"}");
+        return;
+    }
+
+    AlignedFloats hist;
+    if (!current_model()->extract(face, hist)) {
+        async_reply(&mgr, conn_id, 400, "", "{\"error\": \"Image trop petite\"}");
+        return;
+    }
+
+    size_t images, total;
+    {
+        // Sous le verrou exclusif : aucun /reload ne remplace le modèle entre-temps
+        unique_lock<shared_mutex> lock(model_mutex);
+        shared_ptr<LbphMatcher> m = current_model();
+
+        error_code ec;
+        int file_label;
+        bool in_gallery = req.kind == ImageRequest::PATH &&
+                          fs::equivalent(fs::path(req.path).parent_path(), gallery_dir, ec) &&
+                          label_of_file(req.path, file_label) && file_label == label;
+        string file = req.path;
+        if (!in_gallery) {
+            // PNG : sans perte, l'histogramme recalculé au prochain démarrage est identique
+            long long stamp = chrono::duration_cast<chrono::milliseconds>(
+                chrono::system_clock::now().time_since_epoch()).count();
+            file = gallery_dir + "/" + to_string(label) + "_" + to_string(stamp) + ".png";
+            if (!imwrite(file, face)) {
+                async_reply(&mgr, conn_id, 500, "", "{\"error\": \"Ecriture impossible\"}");
+                return;
+            }
+        }
+
+        m->add_histogram(hist.data(), label);
+        images = m->count_label(label);
+        total = m->size();
+        queue_journal_edit(label, hist.data(), m->dim());
+        if (reload_running) reload_edits.push_back({label, move(hist), fs::path(file).filename().string()});
+    }
+    metrics->set_gallery_size(total);
+    // Un inconnu en cache ou suivi pourrait être ce nouveau client
+    cache->clear();
+    tracker->invalidate();
+    schedule_snapshot_save();
+
+    log_info("[LOG] Enrôlement - ID: %d (%zu image(s))", label, images);
+    async_reply(&mgr, conn_id, 200, "Content-Type: application/json\r\n",
+                "{\"client_id\": %d, \"images\": %zu, \"gallery_size\": %zu}", label, images, total);
+}
+
+// Retire un client de la galerie et supprime ses images du dossier.
+static void remove_job(unsigned long conn_id, int label) {
+    size_t removed, files = 0, total;
+    {
+        unique_lock<shared_mutex> lock(model_mutex);
+        shared_ptr<LbphMatcher> m = current_model();
+        removed = m->remove_label(label);
+        queue_journal_edit(label, nullptr, 0);
+        if (reload_running) reload_edits.push_back({label, AlignedFloats(), string()});
+
+        error_code ec;
+        vector<fs::path> to_delete;
+        for (const auto& entry : fs::directory_iterator(gallery_dir, ec)) {
+            int file_label;
+            if (label_of_file(entry.path(), file_label) && file_label == label) {
+                to_delete.push_back(entry.path());
+            }
+        }
+        for (const auto& file : to_delete) {
+            if (fs::remove(file, ec)) files++;
+        }
+        total = m->size();
+    }
+    metrics->set_gallery_size(total);
+    cache->clear();
+    tracker->invalidate();
+    schedule_snapshot_save();
+
+    log_info("[LOG] Suppression - ID: %d (%zu entrée(s), %zu fichier(s))", label, removed, files);
+    async_reply(&mgr, conn_id, 200, "Content-Type: application/json\r\n",
+                "{\"client_id\": %d, \"removed\": %zu, \"gallery_size\": %zu}", label, removed, total);
+}
+
+// Threads d'entraînement d'un /reload (FACE_RELOAD_THREADS, 1 par défaut :
+// les autres coeurs continuent de servir)
+static size_t reload_threads = 1;
+static atomic<bool> reload_busy(false);
+
+/**
+ * Réentraînement complet depuis le dossier clients, sur un thread à part :
+ * l'ancien modèle sert pendant ce temps. Le nouveau reprend le format, l'index
+ * et la recherche parallèle de l'ancien ; les /enroll et /remove arrivés
+ * entre-temps y sont rejoués dans l'ordre (une image déjà relue n'est pas
+ * rajoutée, sauf après une suppression de son client), puis il remplace
+ * l'ancien sous le verrou exclusif, le temps d'un échange de pointeur.
+ * L'ancien est libéré par la dernière requête qui le tenait encore.
+ */
+static void reload_model() {
+    Stopwatch watch;
+    shared_ptr<LbphMatcher> old = current_model();
+    shared_ptr<LbphMatcher> fresh = make_shared<LbphMatcher>(old->params());
+    fresh->set_storage(old->storage());
+    {
+        unique_lock<shared_mutex> lock(model_mutex);
+        reload_running = true;
+        reload_edits.clear();
+    }
+
+    log_info("[INFO] Rechargement du modèle depuis %s...", gallery_dir.c_str());
+    vector<GalleryFile> files;
+    // Instantané écrit après l'échange, par le même job que /enroll
+    bool trained = train_model(*fresh, gallery_dir, "", reload_threads, files);
+    if (trained) finish_model(*fresh, reload_threads);
+
+    set<string> loaded;
+    for (const GalleryFile& f : files) {
+        if (f.status == GalleryFile::LOADED) loaded.insert(fs::path(f.path).filename().string());
+    }
+
+    size_t replayed = 0, total = 0;
+    {
+        unique_lock<shared_mutex> lock(model_mutex);
+        if (trained) {
+            // Rejeu dans l'ordre d'arrivée. Une image relue par le parcours est
+            // déjà dans le modèle, sauf si une suppression de son client a été
+            // rejouée avant : elle l'a effacée, il faut la remettre.
+            set<int> cleared;
+            for (const GalleryEdit& edit : reload_edits) {
+                if (edit.hist.empty()) {
+                    fresh->remove_label(edit.label);
+                    cleared.insert(edit.label);
+                } else if (!loaded.count(edit.file) || cleared.count(edit.label)) {
+                    fresh->add_histogram(edit.hist.data(), edit.label);
+                } else {
+                    continue;
+                }
+                replayed++;
+            }
+            atomic_store(&model, fresh);
+            total = fresh->size();
+        }
+        reload_running = false;
+        reload_edits.clear();
+    }
+
+    if (trained) {
+        metrics->set_gallery_size(total);
+        cache->clear();
+        tracker->invalidate();
+        invalidate_journal();
+        schedule_snapshot_save();
+        log_info("[OK] Modèle rechargé : %zu images (%zu modification(s) rejouée(s)) en %.1f s.", total, replayed,
+                 watch.lap());
+    } else {
+        log_error("[ERREUR] Rechargement abandonné : l'ancien modèle reste en service.");
+    }
+    old.reset();
+    reload_busy = false;
+}
+
+// Lance reload_model() en arrière-plan ; false si un rechargement est déjà en cours.
+static bool start_reload() {
+    if (reload_busy.exchange(true)) return false;
+    thread(reload_model).detach();
+    return true;
+}
+
+/**
+ * Premier chargement (instantané ou entraînement sur FACE_WORKERS threads),
+ * lancé après mg_http_listen. Tient reload_busy : /reload et SIGHUP
+ * attendent la fin. Une galerie vide est servie quand même (tout inconnu),
+ * comme avant.
+ */
+static void load_initial_model(shared_ptr<LbphMatcher> initial, HistStorage storage, bool check_storage) {
+    Stopwatch watch;
+    size_t threads = worker_count_from_env("FACE_WORKERS");
+    vector<GalleryFile> files;
+    train_model(*initial, gallery_dir, snapshot_file, threads, files);
+    if (check_storage) {
+        size_t before = initial->memory_bytes();
+        QuantizationReport q = initial->compare_storage(storage, 64, 2000);
+        initial->set_storage(storage);
+        log_info("[OK] Histogrammes en %s : %zu Mo -> %zu Mo, même résultat %zu/%zu, écart de distance moyen %g %%",
+                 hist_storage_name(storage), before / 1048576, initial->memory_bytes() / 1048576, q.agree,
+                 q.queries, q.mean_rel_error * 100.0);
+    } else if (storage != HIST_FLOAT32) {
+        log_info("[OK] Histogrammes en %s : %zu Mo.", hist_storage_name(storage), initial->memory_bytes() / 1048576);
+    }
+    finish_model(*initial, threads);
+
+    metrics->set_gallery_size(initial->size());
+    atomic_store(&model, initial);
+    log_info("[OK] Modèle prêt en %.1f s : %zu images.", watch.lap(), initial->size());
+    reload_busy = false;
+}
+
+// Avant la fin du premier chargement : 503 immédiat, sans passer par la file
+static bool reject_if_loading(struct mg_connection* c) {
+    if (current_model()) return false;
+    mg_http_reply(c, 503, "Retry-After: 1\r\n", "{\"error\": \"Modèle en cours de chargement\"}");
+    return true;
+}
+
+// SIGHUP : même effet que /reload, traité par la boucle principale
+static volatile sig_atomic_t reload_signal = 0;
+
+static void on_sighup(int) {
+    reload_signal = 1;
+}
+
+// client_id dans l'URL (?client_id=) ou dans le formulaire ; -1 si absent.
+static int get_client_id(struct mg_http_message* hm) {
+    char buf[16] = "";
+    if (mg_http_get_var(&hm->query, "client_id", buf, sizeof(buf)) <= 0) {
+        mg_http_get_var(&hm->body, "client_id", buf, sizeof(buf));
     }
+    char* end = NULL;
+    long id = strtol(buf, &end, 10);
+    return (end != buf && *end == '\0' && id >= 0) ? (int) id : -1;
 }
 
 /**
  * Gestionnaire des requêtes HTTP (Mongoose)
+ * Ne fait que router : tout le travail est délégué au pool de workers.
  */
 static void handle_request(struct mg_connection *c, int ev, void *ev_data) {
     if (ev == MG_EV_HTTP_MSG) {
         struct mg_http_message *hm = (struct mg_http_message *) ev_data;
 
         if (mg_match(hm->uri, mg_str("/identify"), NULL)) {
-            char path[512];
-            mg_http_get_var(&hm->body, "path", path, sizeof(path));
+            if (reject_if_loading(c)) return;
+            ImageRequest req;
+            string error;
+            if (!parse_image_request(hm, req, error)) {
+                metrics->count(ep_identify, OUTCOME_ERROR);
+                mg_http_reply(c, 400, "", "{\"error\": \"%s\"}", error.c_str());
+                return;
+            }
+
+            // ?timing=1 : durée de chaque étape dans l'en-tête Server-Timing
+            char timing[4] = "";
+            mg_http_get_var(&hm->query, "timing", timing, sizeof(timing));
+            bool with_timing = strcmp(timing, "1") == 0;
 
-            Mat test_img = imread(path, IMREAD_GRAYSCALE);
-            if (test_img.empty()) {
-                mg_http_reply(c, 400, "", "{\"error\": \"Image invalide\"}");
+            unsigned long conn_id = c->id;
+            pool->submit([conn_id, req = move(req), with_timing]() { identify_job(conn_id, req, with_timing); });
+        } else if (mg_match(hm->uri, mg_str("/identify_batch"), NULL)) {
+            if (reject_if_loading(c)) return;
+            vector<ImageRequest> reqs;
+            string error;
+            if (!parse_image_batch(hm, reqs, error)) {
+                metrics->count(ep_identify_batch, OUTCOME_ERROR);
+                mg_http_reply(c, 400, "", "{\"error\": \"%s\"}", error.c_str());
                 return;
             }
 
-            int label = -1;
-            double confidence = 0.0;
-            model->predict(test_img, label, confidence);
+            unsigned long conn_id = c->id;
+            pool->submit([conn_id, reqs = move(reqs)]() { identify_batch_job(conn_id, reqs); });
+        } else if (mg_match(hm->uri, mg_str("/identify_frame"), NULL)) {
+            if (reject_if_loading(c)) return;
+            ImageRequest req;
+            string error;
+            if (!parse_image_request(hm, req, error)) {
+                metrics->count(ep_identify_frame, OUTCOME_ERROR);
+                mg_http_reply(c, 400, "", "{\"error\": \"%s\"}", error.c_str());
+                return;
+            }
 
-            cout << "[LOG] Identification - ID: " << label << " | Confiance: " << confidence << endl;
+            // Identifiant de caméra : active le suivi entre images successives
+            char stream[64] = "";
+            mg_http_get_var(&hm->query, "stream", stream, sizeof(stream));
+
+            unsigned long conn_id = c->id;
+            pool->submit([conn_id, req = move(req), s = string(stream)]() { identify_frame_job(conn_id, req, s); });
+        } else if (mg_match(hm->uri, mg_str("/verify"), NULL)) {
+            if (reject_if_loading(c)) return;
+            int label = get_client_id(hm);
+            ImageRequest req;
+            string error;
+            if (label < 0) {
+                metrics->count(ep_verify, OUTCOME_ERROR);
+                mg_http_reply(c, 400, "", "{\"error\": \"client_id manquant\"}");
+                return;
+            }
+            if (!owns_label(label)) {
+                metrics->count(ep_verify, OUTCOME_ERROR);
+                mg_http_reply(c, 421, "", "{\"error\": \"client_id hors de ce shard\"}");
+                return;
+            }
+            if (!parse_image_request(hm, req, error)) {
+                metrics->count(ep_verify, OUTCOME_ERROR);
+                mg_http_reply(c, 400, "", "{\"error\": \"%s\"}", error.c_str());
+                return;
+            }
+
+            unsigned long conn_id = c->id;
+            pool->submit([conn_id, label, req = move(req)]() { verify_job(conn_id, label, req); });
+        } else if (mg_match(hm->uri, mg_str("/enroll"), NULL)) {
+            if (reject_if_loading(c)) return;
+            int label = get_client_id(hm);
+            ImageRequest req;
+            string error;
+            if (label < 0) {
+                mg_http_reply(c, 400, "", "{\"error\": \"client_id manquant\"}");
+                return;
+            }
+            if (!owns_label(label)) {
+                mg_http_reply(c, 421, "", "{\"error\": \"client_id hors de ce shard\"}");
+                return;
+            }
+            if (!parse_image_request(hm, req, error)) {
+                mg_http_reply(c, 400, "", "{\"error\": \"%s\"}", error.c_str());
+                return;
+            }
+
+            unsigned long conn_id = c->id;
+            pool->submit([conn_id, label, req = move(req)]() { enroll_job(conn_id, label, req); });
+        } else if (mg_match(hm->uri, mg_str("/remove"), NULL)) {
+            if (reject_if_loading(c)) return;
+            int label = get_client_id(hm);
+            if (label < 0) {
+                mg_http_reply(c, 400, "", "{\"error\": \"client_id manquant\"}");
+                return;
+            }
+            if (!owns_label(label)) {
+                mg_http_reply(c, 421, "", "{\"error\": \"client_id hors de ce shard\"}");
+                return;
+            }
 
-            // Seuil de confiance LBPH (A ajuster selon l'éclairage)
-            if (label != -1 && confidence < 100.0) {
-                mg_http_reply(c, 200, "Content-Type: application/json\r\n", "{\"client_id\": %d}", label);
+            unsigned long conn_id = c->id;
+            pool->submit([conn_id, label]() { remove_job(conn_id, label); });
+        } else if (mg_match(hm->uri, mg_str("/cache_stats"), NULL)) {
+            mg_http_reply(c, 200, "Content-Type: application/json\r\n",
+                          "{\"hits\": %llu, \"misses\": %llu, \"entries\": %zu, \"capacity\": %zu}",
+                          (unsigned long long) cache->hits(), (unsigned long long) cache->misses(),
+                          cache->size(), cache->capacity());
+        } else if (mg_match(hm->uri, mg_str("/reload"), NULL)) {
+            if (reject_if_loading(c)) return;
+            if (start_reload()) {
+                mg_http_reply(c, 202, "Content-Type: application/json\r\n", "{\"reload\": \"started\"}");
+            } else {
+                mg_http_reply(c, 409, "", "{\"error\": \"Rechargement déjà en cours\"}");
+            }
+        } else if (mg_match(hm->uri, mg_str("/healthz"), NULL)) {
+            // Vivant : la boucle d'événements répond, modèle chargé ou non
+            mg_http_reply(c, 200, "Content-Type: application/json\r\n", "{\"status\": \"ok\"}");
+        } else if (mg_match(hm->uri, mg_str("/readyz"), NULL)) {
+            shared_ptr<LbphMatcher> m = current_model();
+            if (m) {
+                mg_http_reply(c, 200, "Content-Type: application/json\r\n",
+                              "{\"ready\": true, \"gallery_size\": %zu}", m->size());
             } else {
-                mg_http_reply(c, 200, "Content-Type: application/json\r\n", "{\"client_id\": null}");
+                mg_http_reply(c, 503, "Content-Type: application/json\r\n", "{\"ready\": false}");
             }
+        } else if (mg_match(hm->uri, mg_str("/metrics"), NULL)) {
+            string text = metrics->render(pool->pending(), cache->hits(), cache->misses());
+            mg_http_reply(c, 200, "Content-Type: text/plain; version=0.0.4\r\n", "%s", text.c_str());
         }
+    } else if (ev == MG_EV_WAKEUP) {
+        send_async_reply(c, (struct mg_str *) ev_data);
     }
 }
 
 int main() {
-    // 1. Initialisation et Entraînement
-    train_model("../images/clients");
+    // Journal asynchrone : FACE_LOG_LEVEL=debug|info|warn|error (debug : chaque image
+    // chargée), FACE_LOG_RATE lignes par seconde et par thread (0 : illimité)
+    LogConfig log_config;
+    if (!parse_log_level(env_str("FACE_LOG_LEVEL", "info"), log_config.level)) {
+        log_error("Erreur : FACE_LOG_LEVEL doit valoir debug, info, warn ou error");
+        return 1;
+    }
+    log_config.rate = env_int("FACE_LOG_RATE", 200);
+    log_start(log_config);
+
+    // 1. Configuration (le modèle est chargé après le lancement du serveur)
+    gallery_dir = "../images/clients";
+    string shard = env_str("FACE_SHARD", "");
+    if (!shard.empty()) {
+        if (sscanf(shard.c_str(), "%d/%d", &shard_index, &shard_count) != 2 ||
+            shard_count < 1 || shard_index < 0 || shard_index >= shard_count) {
+            log_error("Erreur : FACE_SHARD invalide (attendu i/n, ex: 0/2) : %s", shard.c_str());
+            return 1;
+        }
+    }
+    // Codes LBP (FACE_LBP=full|uniform) : uniforme = 59 cases par cellule au lieu de 256
+    string lbp_mode = env_str("FACE_LBP", "full");
+    if (lbp_mode != "full" && lbp_mode != "uniform") {
+        log_error("Erreur : FACE_LBP doit valoir full ou uniform");
+        return 1;
+    }
+    LbpParams lbp;
+    lbp.uniform = lbp_mode == "uniform";
+    shared_ptr<LbphMatcher> initial = make_shared<LbphMatcher>(lbp);
+
+    // Un instantané par shard : plusieurs instances peuvent partager le dossier
+    snapshot_file = env_str("FACE_SNAPSHOT", shard_count > 1
+        ? "../images/clients.shard" + to_string(shard_index) + "of" + to_string(shard_count) + ".lbph"
+        : "../images/clients.lbph");
+
+    // Galerie en entiers (FACE_HIST_STORAGE=float|u16|u8). Les lignes sont
+    // quantifiées dès le chargement : pas de galerie float intermédiaire.
+    // FACE_HIST_CHECK=1 charge d'abord en float pour mesurer l'écart.
+    HistStorage storage;
+    if (!parse_hist_storage(env_str("FACE_HIST_STORAGE", "float"), storage)) {
+        log_error("Erreur : FACE_HIST_STORAGE doit valoir float, u16 ou u8");
+        return 1;
+    }
+    bool check_storage = storage != HIST_FLOAT32 && env_int("FACE_HIST_CHECK", 0) != 0;
+    if (!check_storage) initial->set_storage(storage);
 
-    // 2. Lancement du serveur Web
-    struct mg_mgr mgr;
+    // Index approché pour les très grandes galeries (FACE_ANN_MIN_SIZE, 0 : recherche exacte)
+    ann_params.min_size = env_int("FACE_ANN_MIN_SIZE", 0);
+    ann_params.probes = env_int("FACE_ANN_PROBES", 8);
+    ann_params.rerank = env_int("FACE_ANN_RERANK", 32);
+
+    // Une requête cherchée sur plusieurs coeurs dès FACE_PARALLEL_MIN_ROWS images
+    // (0 : jamais), en FACE_PARALLEL_THREADS partitions (par défaut un par coeur)
+    int min_rows = env_int("FACE_PARALLEL_MIN_ROWS", 20000);
+    size_t partitions = worker_count_from_env("FACE_PARALLEL_THREADS");
+    if (min_rows > 0 && partitions > 1) {
+        search_pool = make_shared<WorkerPool>(partitions - 1);
+        parallel_min_rows = min_rows;
+        log_info("[INFO] Recherche parallèle : %zu partitions au-delà de %d images.", partitions, min_rows);
+    }
+    reload_threads = max(env_int("FACE_RELOAD_THREADS", 1), 1);
+
+    // Classifieur de visages pour /identify_frame (FACE_CASCADE)
+    cascade_path = env_str("FACE_CASCADE", "/usr/share/opencv4/haarcascades/haarcascade_frontalface_default.xml");
+    if (!CascadeClassifier().load(cascade_path)) {
+        log_warn("[!] Classifieur %s introuvable : /identify_frame indisponible", cascade_path.c_str());
+    }
+    tracker.reset(new FaceTracker(0.3, env_int("FACE_TRACK_REVERIFY", 15), CONFIDENCE_THRESHOLD,
+                                  env_int("FACE_TRACK_MARGIN", 10), env_int("FACE_TRACK_MAX_AGE_MS", 1000)));
+
+    cache.reset(new ResultCache(env_int("FACE_CACHE_SIZE", 256), env_int("FACE_CACHE_TTL_MS", 2000),
+                                env_int("FACE_CACHE_HAMMING", 12)));
+
+    metrics.reset(new ServerMetrics("face"));
+    ep_identify = metrics->add_endpoint("/identify");
+    ep_identify_batch = metrics->add_endpoint("/identify_batch");
+    ep_identify_frame = metrics->add_endpoint("/identify_frame");
+    ep_verify = metrics->add_endpoint("/verify");
+
+    // 2. Pool de workers (FACE_WORKERS, par défaut un par coeur).
+    // OpenCV reste mono-thread par requête : le parallélisme vient du pool.
+    setNumThreads(1);
+    pool.reset(new WorkerPool(worker_count_from_env("FACE_WORKERS")));
+
+    // 3. Lancement du serveur Web
     mg_mgr_init(&mgr);
-    
-    if (mg_http_listen(&mgr, "http://0.0.0.0:8000", handle_request, NULL) == NULL) {
-        cerr << "Erreur : Impossible de lancer le serveur sur le port 8000" << endl;
+    if (!mg_wakeup_init(&mgr)) {
+        log_error("Erreur : Impossible d'initialiser mg_wakeup");
+        return 1;
+    }
+
+    // FACE_PORT : plusieurs instances (shards) sur la même machine
+    int port = env_int("FACE_PORT", 8000);
+    string listen_url = "http://0.0.0.0:" + to_string(port);
+    if (mg_http_listen(&mgr, listen_url.c_str(), handle_request, NULL) == NULL) {
+        log_error("Erreur : Impossible de lancer le serveur sur le port %d", port);
         return 1;
     }
 
-    cout << "--- Serveur Reconnaissance prêt sur http://localhost:8000 ---" << endl;
+    string shard_info = shard_count > 1 ? ", shard " + to_string(shard_index) + "/" + to_string(shard_count) : "";
+    log_info("--- Serveur Reconnaissance à l'écoute sur http://localhost:%d (%zu workers%s) ---", port,
+             pool->size(), shard_info.c_str());
 
-    for (;;) mg_mgr_poll(&mgr, 1000);
+    // 4. Chargement du modèle en arrière-plan : /healthz répond déjà,
+    // /readyz et les routes du modèle attendent la fin (503 d'ici là)
+    reload_busy = true;
+    thread(load_initial_model, initial, storage, check_storage).detach();
+    initial.reset();  // sinon le premier modèle survivrait au premier /reload
+
+    // SIGHUP (kill -HUP) : rechargement comme /reload
+    signal(SIGHUP, on_sighup);
+    for (;;) {
+        mg_mgr_poll(&mgr, 1000);
+        flush_async_replies(&mgr);  // réveils perdus, clients partis
+        if (reload_signal) {
+            reload_signal = 0;
+            if (!start_reload()) log_warn("[!] SIGHUP ignoré : rechargement déjà en cours");
+        }
+    }
 
     mg_mgr_free(&mgr);
     return 0;
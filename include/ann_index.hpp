@@ -0,0 +1,59 @@
+#ifndef ANN_INDEX_HPP
+#define ANN_INDEX_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "lbph_matcher.hpp"
+
+// Réglages de la recherche approchée (voir IvfIndex)
+struct AnnParams {
+    size_t min_size = 0;  // taille de galerie à partir de laquelle l'index est construit (0 : jamais)
+    size_t probes = 8;    // listes parcourues par requête : rappel contre latence
+    size_t rerank = 32;   // candidats recalculés en distance exacte
+};
+
+/**
+ * Index approché pour les très grandes galeries (fichier inversé, IVF).
+ *
+ * Chaque histogramme est résumé en une signature 16 fois plus courte
+ * (somme de 16 cases consécutives). Les signatures sont réparties en
+ * ~sqrt(n) listes par k-moyennes chi-carré. Une requête ne parcourt que
+ * les `probes` listes les plus proches et retient les `rerank` meilleures
+ * signatures ; LbphMatcher recalcule ensuite la distance exacte de ces
+ * candidats.
+ *
+ * L'index garde les numéros de ligne de la galerie : add() à chaque ajout,
+ * remap() après un compactage.
+ */
+class IvfIndex {
+public:
+    IvfIndex(size_t dim, const AnnParams& params);
+
+    const AnnParams& params() const { return params_; }
+    size_t lists() const { return rows_.size(); }
+
+    // Indexe toutes les lignes de `gallery` (quel que soit son stockage)
+    void build(const LbphMatcher& gallery, size_t threads);
+    void add(const float* hist, uint32_t row);
+    // Mêmes règles que LbphMatcher::compact : lignes renumérotées, ordre conservé
+    void remap(const std::vector<char>& keep);
+
+    // Lignes candidates pour `query`, par numéro de ligne croissant
+    void candidates(const float* query, std::vector<uint32_t>& rows) const;
+
+private:
+    void coarsen(const float* hist, float* sig) const;
+    size_t nearest_list(const float* sig) const;
+
+    size_t dim_;
+    size_t sig_dim_;
+    size_t sig_stride_;
+    AnnParams params_;
+
+    AlignedFloats centroids_;                 // lists() x sig_stride_
+    std::vector<std::vector<uint32_t>> rows_;  // par liste : lignes de la galerie
+    std::vector<AlignedFloats> sigs_;          // par liste : signatures contiguës
+};
+
+#endif
@@ -0,0 +1,46 @@
+#ifndef ASYNC_LOG_HPP
+#define ASYNC_LOG_HPP
+
+#include <cstdarg>
+#include <string>
+
+/**
+ * Journal asynchrone des serveurs.
+ *
+ * Chaque thread formate ses lignes dans son propre anneau (un producteur,
+ * un consommateur : deux compteurs atomiques, aucun verrou) ; un thread
+ * d'écriture les vide toutes les quelques millisecondes vers stdout
+ * (DEBUG, INFO) ou stderr (WARN, ERROR), dans l'ordre d'émission.
+ * Un terminal ou un pipe lent ne bloque donc jamais une requête : si
+ * l'anneau est plein, la ligne est perdue et comptée.
+ *
+ * Limitation de débit : au-delà de `rate` lignes par seconde et par
+ * thread, les DEBUG et INFO sont écartées (WARN et ERROR passent
+ * toujours). Les pertes sont signalées périodiquement sur stderr.
+ *
+ * Avant log_start(), les lignes sont écrites directement (démarrage).
+ */
+enum LogLevel { LOG_DEBUG, LOG_INFO, LOG_WARN, LOG_ERROR };
+
+// "debug", "info", "warn", "error"
+bool parse_log_level(const std::string& name, LogLevel& level);
+
+struct LogConfig {
+    LogLevel level = LOG_INFO;
+    int rate = 200;  // lignes DEBUG/INFO par seconde et par thread, 0 : illimité
+};
+
+// Lance le thread d'écriture ; tout est vidé à la sortie du programme.
+void log_start(const LogConfig& config);
+// Vide immédiatement tous les anneaux (bloquant).
+void log_flush();
+
+bool log_enabled(LogLevel level);
+void log_vwrite(LogLevel level, const char* fmt, va_list args);
+
+void log_debug(const char* fmt, ...) __attribute__((format(printf, 1, 2)));
+void log_info(const char* fmt, ...) __attribute__((format(printf, 1, 2)));
+void log_warn(const char* fmt, ...) __attribute__((format(printf, 1, 2)));
+void log_error(const char* fmt, ...) __attribute__((format(printf, 1, 2)));
+
+#endif
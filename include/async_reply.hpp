@@ -0,0 +1,33 @@
+#ifndef ASYNC_REPLY_HPP
+#define ASYNC_REPLY_HPP
+
+#include "mongoose.h"
+
+/**
+ * Réponses HTTP produites par un worker hors de la boucle d'événements.
+ *
+ * Le worker appelle async_reply() (thread-safe) : la réponse est rangée
+ * dans une table protégée par un mutex, et seul son numéro passe par
+ * mg_wakeup (un datagramme de quelques octets, quelle que soit la taille
+ * de la réponse). La boucle reçoit MG_EV_WAKEUP sur la connexion d'origine
+ * et appelle send_async_reply().
+ *
+ * Un réveil peut se perdre (tampon du socket plein, datagramme rejeté) :
+ * flush_async_replies(), appelé après chaque mg_mgr_poll(), envoie ce qui
+ * reste dans la table et oublie les réponses des clients déconnectés.
+ *
+ * mg_wakeup_init() doit avoir été appelé sur le manager.
+ */
+
+// Même sémantique que mg_http_reply(), mais utilisable depuis n'importe quel thread.
+bool async_reply(struct mg_mgr* mgr, unsigned long conn_id, int status,
+                 const char* headers, const char* fmt, ...)
+    __attribute__((format(printf, 5, 6)));
+
+// A appeler dans le handler sur MG_EV_WAKEUP.
+void send_async_reply(struct mg_connection* c, const struct mg_str* data);
+
+// A appeler dans la boucle d'événements, après chaque mg_mgr_poll().
+void flush_async_replies(struct mg_mgr* mgr);
+
+#endif
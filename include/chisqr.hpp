@@ -0,0 +1,57 @@
+#ifndef CHISQR_HPP
+#define CHISQR_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Distance chi-carré "alternative" (cv::HISTCMP_CHISQR_ALT) :
+ *     2 * somme (a-b)^2 / (a+b), termes où |a+b| <= DBL_EPSILON ignorés.
+ *
+ * Comme compareHist, a-b et a+b sont calculés en float puis le quotient
+ * est accumulé en double, donc les distances sont celles de l'ancien
+ * modèle (à l'ordre de sommation près).
+ *
+ * Le noyau (scalaire, SSE2, AVX2, AVX-512) est choisi une fois au
+ * démarrage selon le CPU ; LBPH_KERNEL=scalar|sse2|avx2|avx512 force un choix.
+ */
+typedef double (*chisqr_fn)(const float* a, const float* b, size_t n);
+
+// Variantes pour une ligne de galerie quantifiée (valeur = q * scale) :
+// même calcul une fois la ligne déquantifiée en float, 2 ou 4 fois moins
+// de mémoire lue par comparaison.
+typedef double (*chisqr_u16_fn)(const float* a, const uint16_t* q, float scale, size_t n);
+typedef double (*chisqr_u8_fn)(const float* a, const uint8_t* q, float scale, size_t n);
+
+// Variantes à abandon anticipé : le calcul s'arrête dès que la somme
+// partielle dépasse `bound` (résultat alors > bound). Sinon le résultat est
+// identique, au bit près, à celui du noyau sans borne.
+typedef double (*chisqr_bounded_fn)(const float* a, const float* b, size_t n, double bound);
+typedef double (*chisqr_u16_bounded_fn)(const float* a, const uint16_t* q, float scale, size_t n,
+                                        double bound);
+typedef double (*chisqr_u8_bounded_fn)(const float* a, const uint8_t* q, float scale, size_t n,
+                                       double bound);
+
+// Jeu de noyaux d'un même jeu d'instructions
+struct KernelSet {
+    chisqr_fn f32;
+    chisqr_u16_fn u16;
+    chisqr_u8_fn u8;
+    chisqr_bounded_fn f32_bounded;
+    chisqr_u16_bounded_fn u16_bounded;
+    chisqr_u8_bounded_fn u8_bounded;
+    const char* name;
+};
+
+// Noyaux retenus pour ce CPU
+const KernelSet& chisqr_kernels();
+chisqr_fn chisqr_kernel();
+chisqr_u16_fn chisqr_u16_kernel();
+chisqr_u8_fn chisqr_u8_kernel();
+const char* chisqr_kernel_name();
+
+inline double chisqr_alt(const float* a, const float* b, size_t n) {
+    return chisqr_kernel()(a, b, n);
+}
+
+#endif
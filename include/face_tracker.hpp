@@ -0,0 +1,65 @@
+#ifndef FACE_TRACKER_HPP
+#define FACE_TRACKER_HPP
+
+#include <opencv2/opencv.hpp>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * Association des visages d'une image à ceux de l'image précédente du même
+ * flux caméra (recouvrement IoU, à défaut proximité des centres).
+ *
+ * Une piste est identifiée à sa création puis réutilise son identité ; elle
+ * est revérifiée toutes les `reverify_every` images, à chaque image si sa
+ * distance est à moins de `margin` du seuil d'acceptation `threshold`
+ * (décision incertaine), ou après invalidate(). Une piste non revue depuis
+ * `max_age_ms` disparaît.
+ */
+class FaceTracker {
+public:
+    struct Match {
+        int track_id;
+        bool identify;  // identité à (re)calculer, puis update()
+        int label;
+        double confidence;
+    };
+
+    FaceTracker(double min_iou, int reverify_every, double threshold, double margin, int max_age_ms);
+
+    std::vector<Match> associate(const std::string& stream, const std::vector<cv::Rect>& boxes);
+    void update(const std::string& stream, int track_id, int label, double confidence);
+    void invalidate();
+
+    size_t track_count() const;
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    struct Track {
+        int id;
+        cv::Rect box;
+        int label;
+        double confidence;
+        bool verified;
+        int frames_since_verify;
+        Clock::time_point last_seen;
+    };
+
+    bool needs_identify(const Track& t) const;
+    void expire(Clock::time_point now);
+
+    double min_iou_;
+    int reverify_every_;
+    double threshold_;
+    double margin_;
+    std::chrono::milliseconds max_age_;
+
+    mutable std::mutex mutex_;
+    std::map<std::string, std::vector<Track> > streams_;
+    int next_id_ = 1;
+};
+
+#endif
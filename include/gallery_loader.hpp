@@ -0,0 +1,41 @@
+#ifndef GALLERY_LOADER_HPP
+#define GALLERY_LOADER_HPP
+
+#include <opencv2/opencv.hpp>
+#include <functional>
+#include <string>
+#include <vector>
+#include "lbph_matcher.hpp"
+
+/**
+ * Chargement parallèle d'un dossier d'images "ID.ext" dans une galerie.
+ *
+ * Les fichiers sont triés par nom puis répartis entre `threads` threads ;
+ * chacun décode, prétraite (ex: resize) et extrait l'histogramme, écrit
+ * aussitôt dans sa ligne au format de la galerie (model.storage()) : la
+ * mémoire de pointe est celle de la galerie finale plus une image par
+ * thread. L'ordre final ne dépend que des noms de fichiers, pas de
+ * l'ordonnancement.
+ *
+ * `owns` (optionnel) restreint le chargement à certains labels, par ex.
+ * ceux d'un shard ; les autres fichiers sont marqués SKIPPED sans être lus.
+ */
+struct GalleryFile {
+    enum Status { LOADED, BAD_NAME, BAD_IMAGE, SKIPPED };
+
+    std::string path;
+    int label = -1;
+    Status status = BAD_NAME;
+};
+
+typedef std::function<void(cv::Mat&)> Preprocess;
+typedef std::function<bool(int)> LabelFilter;
+
+// Remplace le contenu de `model`. Retourne tous les fichiers vus, triés,
+// avec leur statut (pour les logs). Lève fs::filesystem_error si le
+// dossier est illisible.
+std::vector<GalleryFile> load_gallery(const std::string& directory_path, LbphMatcher& model,
+                                      size_t threads, const Preprocess& preprocess = nullptr,
+                                      const LabelFilter& owns = nullptr);
+
+#endif
@@ -0,0 +1,47 @@
+#ifndef IMAGE_INPUT_HPP
+#define IMAGE_INPUT_HPP
+
+#include <opencv2/opencv.hpp>
+#include <string>
+#include <vector>
+#include "mongoose.h"
+
+/**
+ * Image reçue par les endpoints d'identification.
+ *
+ * Trois formes acceptées dans le corps du POST :
+ *   - formulaire "path=<fichier>"            (ancien protocole, imread)
+ *   - octets JPEG/PNG (image/jpeg, image/png, application/octet-stream)
+ *   - niveaux de gris bruts 8 bits, avec "?width=W&height=H" dans l'URL
+ *
+ * Le contenu est copié hors de mg_http_message (qui n'est valide que le
+ * temps de l'événement) pour être décodé sur un worker.
+ */
+struct ImageRequest {
+    enum Kind { PATH, ENCODED, RAW_GRAY };
+
+    Kind kind = PATH;
+    std::string path;   // PATH
+    std::string bytes;  // ENCODED / RAW_GRAY
+    int width = 0;      // RAW_GRAY
+    int height = 0;
+};
+
+// Retourne false (et un message d'erreur) si la requête est mal formée.
+bool parse_image_request(struct mg_http_message* hm, ImageRequest& req, std::string& error);
+
+/**
+ * Lot d'images (/identify_batch). Le corps est soit :
+ *   - multipart/form-data, une image par partie
+ *   - une suite d'enregistrements [uint32 longueur little-endian][octets]
+ * Chaque image est encodée (JPEG/PNG), ou brute W*H si "?width=&height="
+ * est présent dans l'URL.
+ */
+bool parse_image_batch(struct mg_http_message* hm, std::vector<ImageRequest>& reqs,
+                       std::string& error);
+
+// Image en niveaux de gris ; vide si le décodage échoue.
+// Pour RAW_GRAY, la Mat référence directement req.bytes (aucune copie).
+cv::Mat decode_image_request(const ImageRequest& req);
+
+#endif
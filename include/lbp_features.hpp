@@ -0,0 +1,39 @@
+#ifndef LBP_FEATURES_HPP
+#define LBP_FEATURES_HPP
+
+#include <opencv2/opencv.hpp>
+#include <cstddef>
+
+/**
+ * Extraction des histogrammes LBP spatiaux.
+ * Reproduit exactement cv::face::LBPHFaceRecognizer (elbp avec
+ * interpolation bilinéaire + spatial_histogram normalisé par cellule),
+ * afin que les distances restent identiques à l'ancien modèle.
+ *
+ * Rayon 1 et 8 voisins (la configuration des serveurs) passent par un
+ * extracteur spécialisé SSE2 en une passe, au résultat identique.
+ *
+ * Mode `uniform` : les codes à au plus 2 transitions 0/1 (motifs uniformes,
+ * 58 pour 8 voisins) gardent chacun leur case, tous les autres partagent
+ * une dernière case. 59 cases par cellule au lieu de 256.
+ */
+struct LbpParams {
+    int radius = 1;
+    int neighbors = 8;
+    int grid_x = 8;
+    int grid_y = 8;
+    bool uniform = false;
+};
+
+// Cases par cellule : 2^neighbors, ou neighbors * (neighbors - 1) + 3 en uniforme.
+size_t lbp_bins(const LbpParams& p);
+// Nombre de floats d'un histogramme : grid_x * grid_y * lbp_bins().
+size_t lbp_histogram_size(const LbpParams& p);
+
+// Calcule l'histogramme de `gray` (CV_8UC1) dans `hist`.
+// Retourne false (hist à zéro) si l'image est trop petite pour la grille.
+bool lbp_histogram(const cv::Mat& gray, const LbpParams& p, float* hist);
+// Même calcul sans l'extracteur spécialisé (référence des tests).
+bool lbp_histogram_generic(const cv::Mat& gray, const LbpParams& p, float* hist);
+
+#endif
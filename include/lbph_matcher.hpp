@@ -0,0 +1,192 @@
+#ifndef LBPH_MATCHER_HPP
+#define LBPH_MATCHER_HPP
+
+#include <opencv2/opencv.hpp>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <string>
+#include <vector>
+#include "lbp_features.hpp"
+
+// Allocateur aligné sur 64 octets (une ligne de cache, un registre AVX-512).
+template <typename T>
+struct AlignedAllocator {
+    typedef T value_type;
+    static const size_t ALIGNMENT = 64;
+
+    AlignedAllocator() = default;
+    template <typename U> AlignedAllocator(const AlignedAllocator<U>&) {}
+
+    T* allocate(size_t n) {
+        size_t bytes = (n * sizeof(T) + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+        void* p = std::aligned_alloc(ALIGNMENT, bytes);
+        if (p == nullptr) throw std::bad_alloc();
+        return static_cast<T*>(p);
+    }
+    void deallocate(T* p, size_t) { std::free(p); }
+
+    template <typename U> bool operator==(const AlignedAllocator<U>&) const { return true; }
+    template <typename U> bool operator!=(const AlignedAllocator<U>&) const { return false; }
+};
+
+typedef std::vector<float, AlignedAllocator<float>> AlignedFloats;
+
+/**
+ * Stockage des histogrammes de la galerie. En entier, chaque ligne garde
+ * son facteur d'échelle (max / 65535 ou max / 255) : 2 ou 4 fois moins de
+ * mémoire, au prix d'une petite erreur de distance (voir compare_storage).
+ */
+enum HistStorage { HIST_FLOAT32, HIST_UINT16, HIST_UINT8 };
+
+const char* hist_storage_name(HistStorage storage);
+// "float", "u16", "u8"
+bool parse_hist_storage(const std::string& name, HistStorage& storage);
+
+// Accord entre la recherche float et la recherche quantifiée (1-NN, sans soi-même)
+struct QuantizationReport {
+    size_t queries = 0;
+    size_t agree = 0;             // même label trouvé
+    double mean_rel_error = 0.0;  // écart relatif moyen de la distance retenue
+};
+
+class IvfIndex;
+struct AnnParams;
+class WorkerPool;
+
+/**
+ * Galerie LBPH et recherche 1:N, en remplacement de
+ * cv::face::LBPHFaceRecognizer.
+ *
+ * Tous les histogrammes sont rangés dans une seule matrice contiguë et
+ * alignée (une ligne de stride() floats par image, complétée par des zéros)
+ * avec un tableau de labels parallèle. La distance est calculée par le
+ * noyau chi-carré SIMD choisi au démarrage (voir chisqr.hpp).
+ *
+ * Comme LBPHFaceRecognizer::predict : plus proche voisin, égalité stricte
+ * (la première image de distance minimale l'emporte), label -1 si vide.
+ *
+ * set_storage() passe la galerie en entiers (HIST_UINT16, HIST_UINT8) ;
+ * les ajouts sont alors quantifiés à la volée.
+ *
+ * Recherche grossier-fin : chaque ligne garde aussi un descripteur grossier
+ * (cellules LBP regroupées en au plus COARSE_GRID x COARSE_GRID blocs, bins
+ * conservés). Le chi-carré entre descripteurs grossiers minore le chi-carré
+ * complet : nearest() écarte sans la lire toute ligne dont la borne dépasse
+ * la meilleure distance courante, et abandonne le calcul complet dès que la
+ * somme partielle la dépasse. Le résultat est celui du parcours complet
+ * (même label, même distance, même règle d'égalité).
+ *
+ * set_parallel_search() découpe en plus la recherche d'une seule requête en
+ * partitions cherchées par plusieurs threads (réduction au minimum), dès
+ * que la galerie atteint un seuil : la latence d'une identification ne
+ * croît plus avec un seul coeur. Mêmes résultats que la recherche en série.
+ *
+ * Pour les très grandes galeries, build_index() ajoute un index approché
+ * (ann_index.hpp) : nearest() ne calcule plus la distance exacte que pour
+ * les candidats de l'index. Il suit les ajouts et suppressions ; train(),
+ * resize() et clear() le retirent.
+ */
+class LbphMatcher {
+public:
+    explicit LbphMatcher(const LbpParams& params = LbpParams());
+    ~LbphMatcher();
+    LbphMatcher(LbphMatcher&&);
+    LbphMatcher& operator=(LbphMatcher&&);
+
+    const LbpParams& params() const { return params_; }
+    size_t size() const { return labels_.size(); }
+    bool empty() const { return labels_.empty(); }
+    size_t dim() const { return dim_; }
+    size_t stride() const { return stride_; }
+    HistStorage storage() const { return storage_; }
+    size_t memory_bytes() const;
+
+    // Ligne i en float (déquantifiée si besoin), dim() floats
+    void copy_histogram(size_t i, float* out) const;
+    int label(size_t i) const { return labels_[i]; }
+
+    // Remplace la galerie (équivalent de LBPHFaceRecognizer::train).
+    void train(const std::vector<cv::Mat>& images, const std::vector<int>& labels);
+
+    // Ajoute une image ; false si elle est inutilisable (trop petite, pas en gris).
+    bool add(const cv::Mat& gray, int label);
+    // Ajoute un histogramme déjà calculé (dim() floats).
+    void add_histogram(const float* hist, int label);
+
+    // Remplissage en parallèle : resize() alloue n lignes à zéro au format
+    // courant (storage()), chaque thread écrit les siennes par set_row()
+    // (quantifiées à l'écriture), puis compact() retire celles restées vides.
+    void resize(size_t n);
+    void set_row(size_t i, const float* hist, int label);
+    void compact(const std::vector<char>& keep);
+
+    // Retire toutes les entrées d'un label ; retourne le nombre supprimé.
+    size_t remove_label(int label);
+    size_t count_label(int label) const;
+
+    void clear();
+    void reserve(size_t n);
+
+    // Convertit toute la galerie ; les ajouts suivants suivent ce format.
+    // Sur une galerie vide, fixe seulement le format du prochain chargement.
+    void set_storage(HistStorage storage);
+    // Mesure, sur au plus `max_rows` lignes, ce que changerait set_storage()
+    QuantizationReport compare_storage(HistStorage storage, size_t queries, size_t max_rows) const;
+
+    // Histogramme de requête au format des lignes de la galerie (stride() floats).
+    bool extract(const cv::Mat& gray, AlignedFloats& query) const;
+
+    void predict(const cv::Mat& gray, int& label, double& distance) const;
+    void nearest(const float* query, int& label, double& distance) const;
+    // Plusieurs requêtes en un parcours de la galerie (mêmes résultats que nearest())
+    void nearest_batch(const std::vector<const float*>& queries, std::vector<int>& labels,
+                       std::vector<double>& distances) const;
+    // Vérification 1:1 : plus petite distance aux seules images de `label` ;
+    // false si ce label n'a aucune image.
+    bool nearest_in_label(const float* query, int label, double& distance) const;
+
+    // Recherche d'une requête partagée entre l'appelant et `pool` à partir
+    // de `min_rows` lignes ; pool nul ou min_rows == 0 : recherche en série.
+    void set_parallel_search(std::shared_ptr<WorkerPool> pool, size_t min_rows);
+
+    // Construit l'index approché si la galerie atteint params.min_size (> 0).
+    bool build_index(const AnnParams& params, size_t threads);
+    const IvfIndex* index() const { return index_.get(); }
+
+private:
+    double row_distance(const float* query, size_t i) const;
+    // Distance exacte si <= bound, sinon une valeur > bound (calcul abandonné)
+    double row_distance_bounded(const float* query, size_t i, double bound) const;
+    void allocate_rows(size_t n);
+    void write_row(size_t i, const float* hist);
+    void store_row(const float* hist);
+    void coarse_of(const float* hist, float* out) const;
+    void coarse_bounds(const float* coarse, size_t begin, size_t end, double* bounds) const;
+    bool bound_exceeds(double bound, double best) const;
+    void update_coarse(size_t i);
+    void nearest_indexed(const float* query, int& label, double& distance) const;
+    void nearest_parallel(const float* query, int& label, double& distance) const;
+    void scan_rows(const float* query, const double* bounds, size_t begin, size_t end,
+                   std::atomic<double>* shared, size_t& best, double& distance) const;
+
+    LbpParams params_;
+    size_t dim_;
+    size_t stride_;
+    size_t coarse_stride_;
+    HistStorage storage_ = HIST_FLOAT32;
+    AlignedFloats data_;  // HIST_FLOAT32
+    std::vector<uint16_t, AlignedAllocator<uint16_t>> data16_;  // HIST_UINT16
+    std::vector<uint8_t, AlignedAllocator<uint8_t>> data8_;     // HIST_UINT8
+    std::vector<float> scales_;                                 // une échelle par ligne entière
+    AlignedFloats coarse_;                                      // descripteurs grossiers
+    std::vector<int> labels_;
+    std::unique_ptr<IvfIndex> index_;
+    std::shared_ptr<WorkerPool> search_pool_;
+    size_t parallel_min_rows_ = 0;
+};
+
+#endif
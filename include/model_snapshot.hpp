@@ -0,0 +1,69 @@
+#ifndef MODEL_SNAPSHOT_HPP
+#define MODEL_SNAPSHOT_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "lbph_matcher.hpp"
+
+/**
+ * Instantané binaire d'une galerie LBPH entraînée, pour démarrer sans
+ * relire ni redécoder toutes les images.
+ *
+ * Format (ordre natif) :
+ *   "LBPHSNAP" | version u32 | radius, neighbors, grid_x, grid_y, uniform u32
+ *   | stockage u32 | réservé u32
+ *   | empreinte du dossier source u64 | nombre u64 | dim u64
+ *   | labels i32[nombre] | histogrammes f32[nombre * dim] | checksum u64
+ *
+ * Les histogrammes sont écrits en float, déquantifiés si la galerie est en
+ * entiers ; le stockage d'origine est noté dans l'en-tête.
+ *
+ * L'instantané n'est accepté que si la version, les paramètres LBP, le
+ * stockage, l'empreinte du dossier et la somme de contrôle correspondent :
+ * une galerie u8/u16 n'est jamais reprise par un serveur en float (ni
+ * l'inverse), qui réentraîne alors à partir des images.
+ *
+ * Journal (`path` + ".journal") : les ajouts et suppressions faits depuis
+ * l'instantané, pour ne pas réécrire toute la galerie à chaque /enroll.
+ *   "LBPHJRNL" | version u32 | réservé u32 | dim u64 | empreinte de l'instantané u64
+ *   puis par enregistrement : label i32 | type u32 | empreinte du dossier u64
+ *   | f32[dim] (ajout seulement) | checksum u64
+ * Les enregistrements sont écrits par lots ; le dernier d'un lot porte
+ * l'empreinte du dossier après le lot. Au chargement, le journal est rejoué
+ * jusqu'au dernier lot complet, dont l'empreinte remplace celle de
+ * l'instantané dans la vérification. save_snapshot() repart sans journal.
+ */
+
+// Empreinte du dossier d'images : noms, tailles et dates de modification
+// des fichiers. `salt` permet d'y mêler le prétraitement propre au serveur.
+uint64_t directory_fingerprint(const std::string& directory_path, const std::string& salt = "");
+
+// Ecrit l'instantané (fichier temporaire puis rename, donc atomique) ligne
+// par ligne, et supprime son journal.
+bool save_snapshot(const std::string& path, const LbphMatcher& model, uint64_t fingerprint);
+
+// Modification de la galerie : ajout d'un histogramme (dim floats) ou,
+// hist vide, suppression de toutes les entrées du label.
+struct JournalEdit {
+    int label;
+    std::vector<float> hist;
+};
+
+std::string journal_path(const std::string& snapshot_path);
+
+// Ajoute `edits` (un lot) au journal de l'instantané d'empreinte `base`,
+// créé au besoin ; `fingerprint` : empreinte du dossier après le lot.
+// false si l'écriture échoue ou si le journal appartient à un autre
+// instantané : il faut alors réécrire l'instantané.
+bool append_journal(const std::string& snapshot_path, size_t dim, uint64_t base,
+                    const std::vector<JournalEdit>& edits, uint64_t fingerprint);
+
+// Charge l'instantané dans `model` (vidé en cas d'échec) puis rejoue son
+// journal ; `reason` explique un refus, `journal_edits` reçoit le nombre
+// de modifications rejouées. Le nombre d'entrées est confronté à la
+// taille du fichier avant toute allocation ; ne lève jamais d'exception.
+bool load_snapshot(const std::string& path, LbphMatcher& model, uint64_t fingerprint,
+                   std::string& reason, size_t* journal_edits = nullptr);
+
+#endif
@@ -0,0 +1,70 @@
+#ifndef RESULT_CACHE_HPP
+#define RESULT_CACHE_HPP
+
+#include <opencv2/opencv.hpp>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+/**
+ * Empreinte perceptuelle (dHash 256 bits) : l'image est réduite en 17x16,
+ * chaque bit indique si un pixel est plus clair que son voisin de droite.
+ * Insensible à la taille, au bruit capteur et aux petites variations
+ * d'éclairage ; deux images proches ont une faible distance de Hamming.
+ */
+struct PHash {
+    uint64_t bits[4];
+};
+
+PHash perceptual_hash(const cv::Mat& gray);
+int hamming_distance(const PHash& a, const PHash& b);
+
+/**
+ * Cache borné des résultats d'identification, y compris les inconnus.
+ *
+ * Une entrée répond à toute image dont l'empreinte est à moins de
+ * `max_hamming` bits et qui n'a pas dépassé `ttl_ms`. Les entrées sont
+ * remplacées en FIFO. clear() (après /enroll, /remove) change la
+ * génération : un résultat calculé avant ne sera pas inséré.
+ * Capacité <= 0 : cache désactivé.
+ */
+class ResultCache {
+public:
+    ResultCache(int capacity, int ttl_ms, int max_hamming);
+
+    uint64_t generation() const { return generation_.load(); }
+    bool lookup(const PHash& key, int& label, double& distance);
+    void insert(const PHash& key, int label, double distance, uint64_t generation);
+    void clear();
+
+    uint64_t hits() const { return hits_.load(std::memory_order_relaxed); }
+    uint64_t misses() const { return misses_.load(std::memory_order_relaxed); }
+    size_t size() const;
+    size_t capacity() const { return capacity_; }
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    struct Entry {
+        PHash key;
+        int label;
+        double distance;
+        Clock::time_point expires;
+    };
+
+    size_t capacity_;
+    std::chrono::milliseconds ttl_;
+    int max_hamming_;
+
+    mutable std::mutex mutex_;
+    std::vector<Entry> entries_;
+    size_t next_ = 0;  // prochaine case remplacée (FIFO)
+
+    std::atomic<uint64_t> generation_{0};
+    std::atomic<uint64_t> hits_{0};
+    std::atomic<uint64_t> misses_{0};
+};
+
+#endif
@@ -0,0 +1,23 @@
+#ifndef SERVER_ENV_HPP
+#define SERVER_ENV_HPP
+
+#include <cstdlib>
+#include <string>
+
+// Lecture de la configuration des serveurs via variables d'environnement
+// (ex: FACE_WORKERS=8 ./bin/face_recognition_server).
+
+inline int env_int(const char* name, int fallback) {
+    const char* v = std::getenv(name);
+    if (v == nullptr || *v == '\0') return fallback;
+    char* end = nullptr;
+    long n = std::strtol(v, &end, 10);
+    return (end != v) ? (int) n : fallback;
+}
+
+inline std::string env_str(const char* name, const std::string& fallback) {
+    const char* v = std::getenv(name);
+    return (v == nullptr || *v == '\0') ? fallback : std::string(v);
+}
+
+#endif
@@ -0,0 +1,104 @@
+#ifndef SERVER_METRICS_HPP
+#define SERVER_METRICS_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Étapes chronométrées d'une requête
+enum Stage { STAGE_DECODE, STAGE_PREPROCESS, STAGE_PREDICT, STAGE_REPLY, STAGE_COUNT };
+
+// Issue d'une identification
+enum Outcome { OUTCOME_MATCH, OUTCOME_UNKNOWN, OUTCOME_ERROR, OUTCOME_COUNT };
+
+const char* stage_name(Stage stage);
+
+// Chronomètre monotone (steady_clock) : lap() rend le temps écoulé depuis
+// le dernier tour, en secondes.
+class Stopwatch {
+public:
+    Stopwatch() : last_(Clock::now()) {}
+    double lap() {
+        Clock::time_point now = Clock::now();
+        double seconds = std::chrono::duration<double>(now - last_).count();
+        last_ = now;
+        return seconds;
+    }
+
+private:
+    typedef std::chrono::steady_clock Clock;
+    Clock::time_point last_;
+};
+
+// Durées d'une requête par étape (une étape peut être absente, ex: cache)
+struct StageTimes {
+    double seconds[STAGE_COUNT] = {};
+    bool measured[STAGE_COUNT] = {};
+
+    void add(Stage stage, double s) {
+        seconds[stage] += s;
+        measured[stage] = true;
+    }
+};
+
+// En-tête "Server-Timing: decode;dur=1.234, ...\r\n" (millisecondes) des
+// étapes mesurées jusqu'ici, à ajouter aux en-têtes de la réponse.
+std::string server_timing_header(const StageTimes& times);
+
+/**
+ * Histogramme de latences à seaux fixes, au format Prometheus.
+ * observe() ne fait que des incréments atomiques relâchés : aucun verrou
+ * sur le chemin des requêtes. Le cumul des seaux est fait à la lecture.
+ */
+class LatencyHistogram {
+public:
+    static const size_t BUCKETS = 14;
+    static const double BOUNDS[BUCKETS];  // secondes, bornes supérieures
+
+    void observe(double seconds);
+    // Lignes _bucket, _sum et _count de la série `name{labels}`
+    void render(std::string& out, const std::string& name, const std::string& labels) const;
+
+private:
+    std::atomic<uint64_t> counts_[BUCKETS + 1] = {};  // dernier seau : +Inf
+    std::atomic<uint64_t> sum_ns_{0};
+};
+
+/**
+ * Métriques d'un serveur de reconnaissance, exposées par /metrics :
+ * identifications par route et par issue, latence par étape, taille de la
+ * galerie, profondeur de la file et succès du cache.
+ *
+ * Les routes sont déclarées au démarrage (add_endpoint), avant tout
+ * appel concurrent ; ensuite tout est atomique.
+ */
+class ServerMetrics {
+public:
+    static const size_t MAX_ENDPOINTS = 16;
+
+    // `prefix` préfixe chaque série (ex: "face" -> face_requests_total)
+    explicit ServerMetrics(const std::string& prefix);
+
+    // Retourne l'indice de la route, à passer à count()
+    size_t add_endpoint(const std::string& path);
+
+    void count(size_t endpoint, Outcome outcome);
+    void observe(Stage stage, double seconds);
+    void observe(const StageTimes& times);
+    void set_gallery_size(size_t n) { gallery_size_.store(n, std::memory_order_relaxed); }
+
+    // Texte Prometheus ; les jauges lues ailleurs sont passées à l'appel.
+    std::string render(size_t queue_depth, uint64_t cache_hits, uint64_t cache_misses) const;
+
+private:
+    std::string prefix_;
+    std::string endpoints_[MAX_ENDPOINTS];
+    size_t endpoint_count_ = 0;
+    std::atomic<uint64_t> requests_[MAX_ENDPOINTS][OUTCOME_COUNT] = {};
+    LatencyHistogram stages_[STAGE_COUNT];
+    std::atomic<size_t> gallery_size_{0};
+};
+
+#endif
@@ -0,0 +1,43 @@
+#ifndef WORKER_POOL_HPP
+#define WORKER_POOL_HPP
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * Pool de threads à taille fixe.
+ * La boucle mongoose y dépose le travail lourd (décodage, predict) pour ne
+ * jamais bloquer mg_mgr_poll ; la réponse revient par mg_wakeup().
+ */
+class WorkerPool {
+public:
+    explicit WorkerPool(size_t threads);
+    ~WorkerPool();
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    void submit(std::function<void()> job);
+
+    size_t size() const { return workers_.size(); }
+    size_t pending() const;
+
+private:
+    void run();
+
+    std::vector<std::thread> workers_;
+    std::deque<std::function<void()>> queue_;
+    mutable std::mutex mutex_;
+    std::condition_variable cv_;
+    bool stopping_ = false;
+};
+
+// Taille du pool : variable d'environnement `env_name`, sinon nombre de coeurs.
+size_t worker_count_from_env(const char* env_name);
+
+#endif
@@ -25,12 +25,12 @@ DB_CONFIG = {
 PATHS = {
     'invoices': '../invoices',
     'temp_faces': '../images/temp',
-    'temp_products': '../images/temp_produit',
-    'cascade': cv2.data.haarcascades + 'haarcascade_frontalface_default.xml'
+    'temp_products': '../images/temp_produit'
 }
 
 API_URLS = {
-    'face_recognition': 'http://localhost:8000/identify',
+    'face_recognition_frame': 'http://localhost:8000/identify_frame',
+    'face_verification': 'http://localhost:8000/verify',
     'product_recognition': 'http://localhost:8080/identify_produit',
     'fingerprint_api': 'http://localhost:5000/api/identify'
 }
@@ -246,29 +246,54 @@ class VisionRecognition:
     """Interface to C++ vision recognition servers"""
     
     @staticmethod
-    def identify_face(image_path):
-        """Send face image to C++ server for identification"""
+    def _post_gray(url, gray_img, **params):
+        """POST raw 8-bit grayscale pixels (no temp file, no JPEG encode)"""
+        h, w = gray_img.shape[:2]
+        return requests.post(
+            url,
+            params={'width': w, 'height': h, **params},
+            data=np.ascontiguousarray(gray_img).tobytes(),
+            headers={'Content-Type': 'application/octet-stream'},
+            timeout=2.0
+        )
+    
+    @staticmethod
+    def verify_face(face_img, client_id):
+        """1:1 check of a grayscale face crop against one claimed client
+        (e.g. the one designated by the fingerprint). Returns True/False,
+        or None if the server could not decide."""
         try:
-            response = requests.post(
-                API_URLS['face_recognition'],
-                data={'path': image_path},
-                timeout=2.0
-            )
+            response = VisionRecognition._post_gray(API_URLS['face_verification'], face_img,
+                                                    client_id=client_id)
             if response.status_code == 200:
-                return response.json().get('client_id')
+                return bool(response.json().get('match'))
         except Exception as e:
-            print(f"  ⚠ Face recognition error: {e}")
+            print(f"  ⚠ Face verification error: {e}")
         return None
     
     @staticmethod
-    def identify_product(image_path):
-        """Send product image to C++ server for identification"""
+    def identify_frame(gray_frame, stream='cam0'):
+        """Detect and identify every face of a grayscale frame server-side.
+        `stream` names the camera: the server tracks faces across its frames
+        and only re-identifies new or uncertain ones.
+        Returns a list of (x, y, w, h, client_id)."""
+        try:
+            response = VisionRecognition._post_gray(API_URLS['face_recognition_frame'], gray_frame,
+                                                    stream=stream)
+            if response.status_code == 200:
+                return [(f['x'], f['y'], f['w'], f['h'], f.get('client_id'))
+                        for f in response.json().get('faces', [])]
+        except Exception as e:
+            print(f"  ⚠ Face recognition error: {e}")
+        return []
+    
+    @staticmethod
+    def identify_product(product_img):
+        """Send product crop (BGR or grayscale) to C++ server for identification"""
         try:
-            response = requests.post(
-                API_URLS['product_recognition'],
-                data={'path': image_path},
-                timeout=2.0
-            )
+            if product_img.ndim == 3:
+                product_img = cv2.cvtColor(product_img, cv2.COLOR_BGR2GRAY)
+            response = VisionRecognition._post_gray(API_URLS['product_recognition'], product_img)
             if response.status_code == 200:
                 data = response.json()
                 return data.get('produit_id'), data.get('confidence', 0)
@@ -307,12 +332,12 @@ class SmartStoreSystem:
         self.db = DatabaseManager(DB_CONFIG)
         self.vision = VisionRecognition()
         self.fingerprint = FingerprintInterface()
-        self.face_cascade = cv2.CascadeClassifier(PATHS['cascade'])
         
         # Tracking state
         self.active_sessions = {}  # {client_id: session_data}
         self.product_detections = {}  # Anti-bounce
         self.last_face_check = {}
+        self.last_face_crop = {}  # {client_id: 200x200 crop}, checked at payment
         
         # Create temp directories
         for path in PATHS.values():
@@ -321,22 +346,10 @@ class SmartStoreSystem:
     
     def detect_and_identify_client(self, frame, gray):
         """Detect face and identify client"""
-        faces = self.face_cascade.detectMultiScale(gray, 1.3, 5)
-        
         current_clients = []
         
-        for (x, y, w, h) in faces:
-            # Extract face ROI
-            face_img = gray[y:y+h, x:x+w]
-            face_img_resized = cv2.resize(face_img, (200, 200))
-            
-            # Save temporarily
-            img_path = os.path.join(PATHS['temp_faces'], "current_face.jpg")
-            cv2.imwrite(img_path, face_img_resized)
-            
-            # Identify via C++ server
-            client_id = self.vision.identify_face(img_path)
-            
+        # Detection, cropping and identification all happen in the C++ server
+        for (x, y, w, h, client_id) in self.vision.identify_frame(gray):
             if client_id:
                 current_clients.append(client_id)
                 
@@ -349,12 +362,14 @@ class SmartStoreSystem:
                 if client_id not in self.active_sessions:
                     self.start_shopping_session(client_id)
                 
-                # Verify face periodically
+                # Verify face periodically; keep a recent crop for the
+                # payment, where the fingerprint designates the client
                 now = time.time()
                 if client_id not in self.last_face_check or \
                    (now - self.last_face_check[client_id]) > 5:
                     session = self.active_sessions[client_id]
                     self.db.verify_face_match(session['session_id'], True)
+                    self.last_face_crop[client_id] = cv2.resize(gray[y:y+h, x:x+w], (200, 200))
                     self.last_face_check[client_id] = now
                     
             else:
@@ -386,11 +401,9 @@ class SmartStoreSystem:
             
             # Extract product ROI
             roi = frame[y1:y2, x1:x2]
-            prod_path = os.path.join(PATHS['temp_products'], "scan_product.jpg")
-            cv2.imwrite(prod_path, roi)
             
             # Identify product
-            product_id, confidence = self.vision.identify_product(prod_path)
+            product_id, confidence = self.vision.identify_product(roi)
             
             if product_id and confidence > 0:
                 # Anti-bounce: require consistent detection
@@ -498,8 +511,20 @@ class SmartStoreSystem:
             True
         )
         
-        # Verify face + fingerprint match
-        self.db.verify_fingerprint_match(session['session_id'], True)
+        # Verify face + fingerprint match: 1:1 check of the face seen in
+        # the store against the client designated by the fingerprint
+        crop = self.last_face_crop.get(client_id)
+        verified = None
+        if crop is not None:
+            verified = self.vision.verify_face(crop, client_data['client_id'])
+        self.db.verify_fingerprint_match(session['session_id'], bool(verified))
+        
+        if not verified:
+            if verified is None:
+                print("  ✗ Face verification unavailable")
+            else:
+                print("  ✗ Face does not match fingerprint")
+            return False
         
         # Create transaction
         transaction_id = self.db.create_transaction(
@@ -526,6 +551,7 @@ class SmartStoreSystem:
         
         # Clear session
         del self.active_sessions[client_id]
+        self.last_face_crop.pop(client_id, None)
         
         print(f"\n  ✓ PAYMENT SUCCESSFUL")
         print(f"  Transaction ID: {transaction_id}")
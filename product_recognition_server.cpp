@@ -1,53 +1,262 @@
 #include <opencv2/opencv.hpp>
-#include <opencv2/face.hpp>
 #include "external/mongoose.h"
-#include <iostream>
+#include "ann_index.hpp"
+#include "async_log.hpp"
+#include "async_reply.hpp"
+#include "image_input.hpp"
+#include "gallery_loader.hpp"
+#include "lbph_matcher.hpp"
+#include "model_snapshot.hpp"
+#include "result_cache.hpp"
+#include "server_metrics.hpp"
+#include "chisqr.hpp"
+#include "server_env.hpp"
+#include "worker_pool.hpp"
+#include <atomic>
+#include <cfloat>
+#include <csignal>
+#include <memory>
+#include <thread>
 #include <vector>
-#include <filesystem>
 #include <string>
 
-namespace fs = std::filesystem;  // ✓ Correct
 using namespace cv;
-using namespace cv::face;
 using namespace std;
 
-Ptr<LBPHFaceRecognizer> model = LBPHFaceRecognizer::create();
+// Modèle courant, compté par références : /reload en construit un autre à
+// côté et le remplace d'un coup (atomic_store) ; une requête garde le sien.
+static shared_ptr<LbphMatcher> model;
 // Taille standard pour l'entraînement (doit être la même que tes images dans /produits)
 const Size TRAINING_SIZE(200, 200); 
 
-void train_model(const string& directory_path) {
-    vector<Mat> images;
-    vector<int> labels;
-    cout << "[INFO] Entraînement du modèle en cours..." << endl;
+static shared_ptr<LbphMatcher> current_model() {
+    return atomic_load(&model);
+}
+
+/**
+ * Charge les images produits dans `target` sur `threads` threads. Avec
+ * `reuse_snapshot`, l'instantané est repris s'il est à jour ; sinon (ou
+ * pour /reload) le modèle est réentraîné puis l'instantané réécrit.
+ * Retourne false si aucune image n'a pu être chargée.
+ */
+static bool train_model(LbphMatcher& target, const string& directory_path, const string& snapshot_path,
+                        bool reuse_snapshot, size_t threads) {
+    // Démarrage rapide : instantané valide tant que le dossier n'a pas changé
+    uint64_t fingerprint = directory_fingerprint(directory_path,
+        "resize=" + to_string(TRAINING_SIZE.width) + "x" + to_string(TRAINING_SIZE.height));
+    string reason = "rechargement demandé";
+    if (reuse_snapshot && load_snapshot(snapshot_path, target, fingerprint, reason)) {
+        log_info("[OK] Modèle chargé depuis %s (%zu images, noyau chi2 : %s).", snapshot_path.c_str(),
+                 target.size(), chisqr_kernel_name());
+        return true;
+    }
+    log_info("[INFO] Instantané %s ignoré (%s).", snapshot_path.c_str(), reason.c_str());
+
+    log_info("[INFO] Entraînement du modèle en cours...");
 
     try {
-        for (const auto& entry : fs::directory_iterator(directory_path)) {
-            string path = entry.path().string();
-            string filename = entry.path().stem().string();
-
-            try {
-                int label = stoi(filename);
-                Mat img = imread(path, IMREAD_GRAYSCALE);
-                if (!img.empty()) {
-                    // On redimensionne pour être sûr de la cohérence
-                    resize(img, img, TRAINING_SIZE);
-                    images.push_back(img);
-                    labels.push_back(label);
-                    cout << "  > Chargé : produit " << label << " (" << path << ")" << endl;
-                }
-            } catch (...) { /* Ignorer fichiers non-ID */ }
+        // Décodage, redimensionnement et extraction répartis sur les coeurs.
+        // On redimensionne pour être sûr de la cohérence.
+        vector<GalleryFile> files = load_gallery(directory_path, target, threads,
+                                                 [](Mat& img) { resize(img, img, TRAINING_SIZE); });
+        for (const auto& f : files) {
+            if (f.status == GalleryFile::LOADED) {
+                log_debug("  > Chargé : produit %d (%s)", f.label, f.path.c_str());
+            }
         }
 
-        if (images.empty()) {
-            cerr << "[ERREUR] Aucune image trouvée !" << endl;
-            return;
+        if (target.empty()) {
+            log_error("[ERREUR] Aucune image trouvée !");
+            return false;
         }
 
-        model->train(images, labels);
-        cout << "[OK] Modèle entraîné avec " << images.size() << " images." << endl;
+        log_info("[OK] Modèle entraîné avec %zu images (noyau chi2 : %s).", target.size(), chisqr_kernel_name());
+
+        if (save_snapshot(snapshot_path, target, fingerprint)) {
+            log_info("[OK] Instantané écrit : %s", snapshot_path.c_str());
+        } else {
+            log_warn("[!] Impossible d'écrire l'instantané %s", snapshot_path.c_str());
+        }
+        return true;
     } catch (const exception& e) {
-        cerr << "[ERREUR FATALE] : " << e.what() << endl;
+        log_error("[ERREUR FATALE] : %s", e.what());
+        return false;
+    }
+}
+
+// Réglages repris par chaque modèle construit (démarrage et /reload)
+static AnnParams ann_params;
+static shared_ptr<WorkerPool> search_pool;
+static size_t parallel_min_rows = 0;
+
+// Index approché (construit sur `threads` threads, comme l'entraînement)
+// et recherche parallèle d'un modèle fraîchement entraîné
+static void finish_model(LbphMatcher& m, size_t threads) {
+    if (m.build_index(ann_params, threads)) {
+        log_info("[OK] Index approché : %zu listes (probes %zu, rerank %zu).", m.index()->lists(),
+                 ann_params.probes, ann_params.rerank);
+    }
+    if (search_pool) m.set_parallel_search(search_pool, parallel_min_rows);
+}
+
+// Boucle d'événements et pool partagés avec les workers (mg_wakeup)
+static struct mg_mgr mgr;
+static unique_ptr<WorkerPool> pool;
+// Résultats récents, y compris "produit inconnu" (PRODUCT_CACHE_*)
+static unique_ptr<ResultCache> cache;
+// Compteurs et latences exposés par /metrics
+static unique_ptr<ServerMetrics> metrics;
+static size_t ep_identify;
+
+// Distance au format JSON : null sans aucune image comparée (aucun produit
+// chargé), où la distance vaut DBL_MAX (plus de 300 chiffres en %.2f)
+static string confidence_json(double confidence) {
+    if (confidence >= DBL_MAX) return "null";
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%.2f", confidence);
+    return buf;
+}
+
+// Exécuté sur un worker : décodage, redimensionnement, predict.
+// `timing` (?timing=1) : durée de chaque étape dans l'en-tête Server-Timing.
+static void identify_job(unsigned long conn_id, const ImageRequest& req, bool timing) {
+    if (req.kind == ImageRequest::PATH) {
+        log_info("[RECU] Analyse de l'image : %s", req.path.c_str());
+    } else {
+        log_info("[RECU] Analyse d'une image de %zu octets", req.bytes.size());
     }
+
+    StageTimes times;
+    Stopwatch watch;
+    Mat test_img = decode_image_request(req);
+    times.add(STAGE_DECODE, watch.lap());
+    if (test_img.empty()) {
+        metrics->count(ep_identify, OUTCOME_ERROR);
+        metrics->observe(times);
+        async_reply(&mgr, conn_id, 400, "", "{\"error\": \"Image introuvable\"}");
+        return;
+    }
+
+    // IMPORTANT : Redimensionner l'image reçue à la taille d'entraînement
+    resize(test_img, test_img, TRAINING_SIZE);
+
+    // Galerie figée : une image quasi identique donne le même résultat
+    int label = -1;
+    double confidence = 0.0;
+    PHash key = perceptual_hash(test_img);
+    if (!cache->lookup(key, label, confidence)) {
+        // Modèle lu après la génération : pas de résultat périmé en cache après /reload
+        uint64_t generation = cache->generation();
+        shared_ptr<LbphMatcher> m = current_model();
+        AlignedFloats query;
+        bool usable = m->extract(test_img, query);
+        times.add(STAGE_PREPROCESS, watch.lap());
+        label = -1;
+        confidence = DBL_MAX;
+        if (usable) m->nearest(query.data(), label, confidence);
+        times.add(STAGE_PREDICT, watch.lap());
+        cache->insert(key, label, confidence, generation);
+    } else {
+        times.add(STAGE_PREPROCESS, watch.lap());
+    }
+
+    // LOG de debug pour t'aider à régler le seuil
+    log_info("[RESULTAT] ID: %d | Confiance (Distance): %g", label, confidence);
+
+    // Ajustement du seuil : Pour LBPH, entre 80 et 150 est souvent nécessaire pour les objets
+    bool match = label != -1 && confidence < 90.0;
+    string headers = "Content-Type: application/json\r\n";
+    if (timing) headers += server_timing_header(times);
+    if (match) { 
+        async_reply(&mgr, conn_id, 200, headers.c_str(), "{\"produit_id\": %d, \"confidence\": %.2f}", label, confidence);
+    } else {
+        async_reply(&mgr, conn_id, 200, headers.c_str(), "{\"produit_id\": null, \"confidence\": %s}",
+                    confidence_json(confidence).c_str());
+    }
+    times.add(STAGE_REPLY, watch.lap());
+    metrics->count(ep_identify, match ? OUTCOME_MATCH : OUTCOME_UNKNOWN);
+    metrics->observe(times);
+}
+
+// Dossier des produits et instantané associé (fixés dans main)
+static string product_dir;
+static string snapshot_file;
+// Threads d'entraînement d'un /reload (PRODUCT_RELOAD_THREADS, 1 par défaut)
+static size_t reload_threads = 1;
+static atomic<bool> reload_busy(false);
+
+/**
+ * Réentraînement complet depuis le dossier produits, sur un thread à part :
+ * l'ancien modèle sert pendant ce temps, puis le nouveau (même format,
+ * index et recherche parallèle) le remplace d'un échange de pointeur.
+ * L'ancien est libéré par la dernière requête qui le tenait encore.
+ */
+static void reload_model() {
+    Stopwatch watch;
+    shared_ptr<LbphMatcher> old = current_model();
+    shared_ptr<LbphMatcher> fresh = make_shared<LbphMatcher>(old->params());
+    fresh->set_storage(old->storage());
+
+    log_info("[INFO] Rechargement du modèle depuis %s...", product_dir.c_str());
+    if (train_model(*fresh, product_dir, snapshot_file, false, reload_threads)) {
+        finish_model(*fresh, reload_threads);
+        atomic_store(&model, fresh);
+        metrics->set_gallery_size(fresh->size());
+        cache->clear();
+        log_info("[OK] Modèle rechargé : %zu images en %.1f s.", fresh->size(), watch.lap());
+    } else {
+        log_error("[ERREUR] Rechargement abandonné : l'ancien modèle reste en service.");
+    }
+    old.reset();
+    reload_busy = false;
+}
+
+// Lance reload_model() en arrière-plan ; false si un rechargement est déjà en cours.
+static bool start_reload() {
+    if (reload_busy.exchange(true)) return false;
+    thread(reload_model).detach();
+    return true;
+}
+
+/**
+ * Premier chargement (instantané ou entraînement sur PRODUCT_WORKERS
+ * threads), lancé après mg_http_listen. Tient reload_busy : /reload et
+ * SIGHUP attendent la fin.
+ */
+static void load_initial_model(shared_ptr<LbphMatcher> initial, HistStorage storage, bool check_storage) {
+    Stopwatch watch;
+    size_t threads = worker_count_from_env("PRODUCT_WORKERS");
+    train_model(*initial, product_dir, snapshot_file, true, threads);
+    if (check_storage) {
+        size_t before = initial->memory_bytes();
+        QuantizationReport q = initial->compare_storage(storage, 64, 2000);
+        initial->set_storage(storage);
+        log_info("[OK] Histogrammes en %s : %zu Mo -> %zu Mo, même résultat %zu/%zu, écart de distance moyen %g %%",
+                 hist_storage_name(storage), before / 1048576, initial->memory_bytes() / 1048576, q.agree,
+                 q.queries, q.mean_rel_error * 100.0);
+    } else if (storage != HIST_FLOAT32) {
+        log_info("[OK] Histogrammes en %s : %zu Mo.", hist_storage_name(storage), initial->memory_bytes() / 1048576);
+    }
+    finish_model(*initial, threads);
+
+    metrics->set_gallery_size(initial->size());
+    atomic_store(&model, initial);
+    log_info("[OK] Modèle prêt en %.1f s : %zu images.", watch.lap(), initial->size());
+    reload_busy = false;
+}
+
+// Avant la fin du premier chargement : 503 immédiat, sans passer par la file
+static bool reject_if_loading(struct mg_connection* c) {
+    if (current_model()) return false;
+    mg_http_reply(c, 503, "Retry-After: 1\r\n", "{\"error\": \"Modèle en cours de chargement\"}");
+    return true;
+}
+
+// SIGHUP : même effet que /reload, traité par la boucle principale
+static volatile sig_atomic_t reload_signal = 0;
+
+static void on_sighup(int) {
+    reload_signal = 1;
 }
 
 static void handle_request(struct mg_connection *c, int ev, void *ev_data) {
@@ -55,50 +264,141 @@ static void handle_request(struct mg_connection *c, int ev, void *ev_data) {
         struct mg_http_message *hm = (struct mg_http_message *) ev_data;
 
         if (mg_match(hm->uri, mg_str("/identify_produit"), NULL)) {
-            char path[512];
-            mg_http_get_var(&hm->body, "path", path, sizeof(path));
-
-            cout << "[RECU] Analyse de l'image : " << path << endl;
-
-            Mat test_img = imread(path, IMREAD_GRAYSCALE);
-            if (test_img.empty()) {
-                mg_http_reply(c, 400, "", "{\"error\": \"Image introuvable\"}");
+            if (reject_if_loading(c)) return;
+            ImageRequest req;
+            string error;
+            if (!parse_image_request(hm, req, error)) {
+                metrics->count(ep_identify, OUTCOME_ERROR);
+                mg_http_reply(c, 400, "", "{\"error\": \"%s\"}", error.c_str());
                 return;
             }
 
-            // IMPORTANT : Redimensionner l'image reçue à la taille d'entraînement
-            resize(test_img, test_img, TRAINING_SIZE);
+            char timing[4] = "";
+            mg_http_get_var(&hm->query, "timing", timing, sizeof(timing));
+            bool with_timing = strcmp(timing, "1") == 0;
 
-            int label = -1;
-            double confidence = 0.0;
-            model->predict(test_img, label, confidence);
-
-            // LOG de debug pour t'aider à régler le seuil
-            cout << "[RESULTAT] ID: " << label << " | Confiance (Distance): " << confidence << endl;
-
-            // Ajustement du seuil : Pour LBPH, entre 80 et 150 est souvent nécessaire pour les objets
-            if (label != -1 && confidence < 90.0) { 
-                mg_http_reply(c, 200, "Content-Type: application/json\r\n", "{\"produit_id\": %d, \"confidence\": %.2f}", label, confidence);
+            unsigned long conn_id = c->id;
+            pool->submit([conn_id, req = move(req), with_timing]() { identify_job(conn_id, req, with_timing); });
+        } else if (mg_match(hm->uri, mg_str("/cache_stats"), NULL)) {
+            mg_http_reply(c, 200, "Content-Type: application/json\r\n",
+                          "{\"hits\": %llu, \"misses\": %llu, \"entries\": %zu, \"capacity\": %zu}",
+                          (unsigned long long) cache->hits(), (unsigned long long) cache->misses(),
+                          cache->size(), cache->capacity());
+        } else if (mg_match(hm->uri, mg_str("/reload"), NULL)) {
+            if (reject_if_loading(c)) return;
+            if (start_reload()) {
+                mg_http_reply(c, 202, "Content-Type: application/json\r\n", "{\"reload\": \"started\"}");
+            } else {
+                mg_http_reply(c, 409, "", "{\"error\": \"Rechargement déjà en cours\"}");
+            }
+        } else if (mg_match(hm->uri, mg_str("/healthz"), NULL)) {
+            // Vivant : la boucle d'événements répond, modèle chargé ou non
+            mg_http_reply(c, 200, "Content-Type: application/json\r\n", "{\"status\": \"ok\"}");
+        } else if (mg_match(hm->uri, mg_str("/readyz"), NULL)) {
+            shared_ptr<LbphMatcher> m = current_model();
+            if (m) {
+                mg_http_reply(c, 200, "Content-Type: application/json\r\n",
+                              "{\"ready\": true, \"gallery_size\": %zu}", m->size());
             } else {
-                mg_http_reply(c, 200, "Content-Type: application/json\r\n", "{\"produit_id\": null, \"confidence\": %.2f}", confidence);
+                mg_http_reply(c, 503, "Content-Type: application/json\r\n", "{\"ready\": false}");
             }
+        } else if (mg_match(hm->uri, mg_str("/metrics"), NULL)) {
+            string text = metrics->render(pool->pending(), cache->hits(), cache->misses());
+            mg_http_reply(c, 200, "Content-Type: text/plain; version=0.0.4\r\n", "%s", text.c_str());
         }
+    } else if (ev == MG_EV_WAKEUP) {
+        send_async_reply(c, (struct mg_str *) ev_data);
     }
 }
 
 int main() {
-    train_model("../images/produits");
+    // Journal asynchrone : PRODUCT_LOG_LEVEL=debug|info|warn|error (debug : chaque image
+    // chargée), PRODUCT_LOG_RATE lignes par seconde et par thread (0 : illimité)
+    LogConfig log_config;
+    if (!parse_log_level(env_str("PRODUCT_LOG_LEVEL", "info"), log_config.level)) {
+        log_error("Erreur : PRODUCT_LOG_LEVEL doit valoir debug, info, warn ou error");
+        return 1;
+    }
+    log_config.rate = env_int("PRODUCT_LOG_RATE", 200);
+    log_start(log_config);
+
+    // Codes LBP (PRODUCT_LBP=full|uniform) : uniforme = 59 cases par cellule au lieu de 256
+    string lbp_mode = env_str("PRODUCT_LBP", "full");
+    if (lbp_mode != "full" && lbp_mode != "uniform") {
+        log_error("Erreur : PRODUCT_LBP doit valoir full ou uniform");
+        return 1;
+    }
+    LbpParams lbp;
+    lbp.uniform = lbp_mode == "uniform";
+    shared_ptr<LbphMatcher> initial = make_shared<LbphMatcher>(lbp);
+    product_dir = "../images/produits";
+    snapshot_file = env_str("PRODUCT_SNAPSHOT", "../images/produits.lbph");
+
+    // Galerie en entiers (PRODUCT_HIST_STORAGE=float|u16|u8). Les lignes sont
+    // quantifiées dès le chargement : pas de galerie float intermédiaire.
+    // PRODUCT_HIST_CHECK=1 charge d'abord en float pour mesurer l'écart.
+    HistStorage storage;
+    if (!parse_hist_storage(env_str("PRODUCT_HIST_STORAGE", "float"), storage)) {
+        log_error("Erreur : PRODUCT_HIST_STORAGE doit valoir float, u16 ou u8");
+        return 1;
+    }
+    bool check_storage = storage != HIST_FLOAT32 && env_int("PRODUCT_HIST_CHECK", 0) != 0;
+    if (!check_storage) initial->set_storage(storage);
+
+    // Index approché pour les très grandes galeries (PRODUCT_ANN_MIN_SIZE, 0 : recherche exacte)
+    ann_params.min_size = env_int("PRODUCT_ANN_MIN_SIZE", 0);
+    ann_params.probes = env_int("PRODUCT_ANN_PROBES", 8);
+    ann_params.rerank = env_int("PRODUCT_ANN_RERANK", 32);
+
+    // Une requête cherchée sur plusieurs coeurs dès PRODUCT_PARALLEL_MIN_ROWS images
+    // (0 : jamais), en PRODUCT_PARALLEL_THREADS partitions (par défaut un par coeur)
+    int min_rows = env_int("PRODUCT_PARALLEL_MIN_ROWS", 20000);
+    size_t partitions = worker_count_from_env("PRODUCT_PARALLEL_THREADS");
+    if (min_rows > 0 && partitions > 1) {
+        search_pool = make_shared<WorkerPool>(partitions - 1);
+        parallel_min_rows = min_rows;
+        log_info("[INFO] Recherche parallèle : %zu partitions au-delà de %d images.", partitions, min_rows);
+    }
+    reload_threads = max(env_int("PRODUCT_RELOAD_THREADS", 1), 1);
+
+    cache.reset(new ResultCache(env_int("PRODUCT_CACHE_SIZE", 256), env_int("PRODUCT_CACHE_TTL_MS", 2000),
+                                env_int("PRODUCT_CACHE_HAMMING", 12)));
+
+    metrics.reset(new ServerMetrics("product"));
+    ep_identify = metrics->add_endpoint("/identify_produit");
+
+    setNumThreads(1);
+    pool.reset(new WorkerPool(worker_count_from_env("PRODUCT_WORKERS")));
 
-    struct mg_mgr mgr;
     mg_mgr_init(&mgr);
+    if (!mg_wakeup_init(&mgr)) {
+        log_error("Erreur mg_wakeup");
+        return 1;
+    }
     
     if (mg_http_listen(&mgr, "http://0.0.0.0:8080", handle_request, NULL) == NULL) {
-        cerr << "Erreur port 8080" << endl;
+        log_error("Erreur port 8080");
         return 1;
     }
 
-    cout << "--- Serveur Reconnaissance Produit actif sur le port 8080 ---" << endl;
-    for (;;) mg_mgr_poll(&mgr, 1000);
+    log_info("--- Serveur Reconnaissance Produit à l'écoute sur le port 8080 (%zu workers) ---", pool->size());
+
+    // Chargement du modèle en arrière-plan : /healthz répond déjà,
+    // /readyz et /identify_produit attendent la fin (503 d'ici là)
+    reload_busy = true;
+    thread(load_initial_model, initial, storage, check_storage).detach();
+    initial.reset();  // sinon le premier modèle survivrait au premier /reload
+
+    // SIGHUP (kill -HUP) : rechargement comme /reload
+    signal(SIGHUP, on_sighup);
+    for (;;) {
+        mg_mgr_poll(&mgr, 1000);
+        flush_async_replies(&mgr);  // réveils perdus, clients partis
+        if (reload_signal) {
+            reload_signal = 0;
+            if (!start_reload()) log_warn("[!] SIGHUP ignoré : rechargement déjà en cours");
+        }
+    }
 
     return 0;
 }
\ No newline at end of file
@@ -8,6 +8,7 @@
 #define DB_PATH "database/smart_store.db"
 #define SERIAL_PORT "/dev/ttyACM0"
 #define API_NOTIFICATION_URL "http://localhost:5000/api/register"
+#define FACE_ENROLL_URL "http://localhost:8000/enroll"
 
 // Forward declarations
 void clear_screen();
@@ -16,6 +17,7 @@ void print_header(const char* title);
 int capture_face_image(int id, char* output_path);
 int capture_product_image(int id, char* output_path);
 void send_registration_to_api(int client_id, const char* type);
+void enroll_face_on_server(int label, const char* image_path);
 void list_products();
 void list_all_products();
 
@@ -105,11 +107,13 @@ void register_client() {
     
     // Call Python script to capture face
     int temp_id = get_next_available_id();
+    int face_label = temp_id;
     if (capture_face_image(temp_id, face_image_path) != 0) {
         printf("\n✗ FACE CAPTURE FAILED\n");
         printf("Using default path...\n");
         snprintf(face_image_path, sizeof(face_image_path), 
                 "../images/clients/%d.jpg", fingerprint_id);
+        face_label = fingerprint_id;
     }
     
     printf("✓ Face image saved: %s\n", face_image_path);
@@ -136,6 +140,9 @@ void register_client() {
         // Notify API
         send_registration_to_api(client_id, "client");
         
+        // Make the face recognizable right away (no server restart)
+        enroll_face_on_server(face_label, face_image_path);
+        
     } else {
         printf("\n✗ DATABASE ERROR: Failed to save client\n");
     }
@@ -460,6 +467,27 @@ void send_registration_to_api(int id, const char* type) {
     system(cmd);
 }
 
+void enroll_face_on_server(int label, const char* image_path) {
+    printf("→ Enrolling face on recognition server...\n");
+    
+    char abs_path[4096];
+    if (realpath(image_path, abs_path) == NULL) {
+        printf("✗ Face image not found: %s\n", image_path);
+        return;
+    }
+    
+    char cmd[4352];
+    snprintf(cmd, sizeof(cmd),
+            "curl -s -X POST %s "
+            "--data-urlencode 'client_id=%d' "
+            "--data-urlencode 'path=%s' >/dev/null 2>&1",
+            FACE_ENROLL_URL, label, abs_path);
+    
+    if (system(cmd) != 0) {
+        printf("⚠ Face server unreachable, client will be recognized after restart\n");
+    }
+}
+
 // ==================== MAIN PROGRAM ====================
 
 int main() {
@@ -0,0 +1,296 @@
+#include "external/mongoose.h"
+#include "server_env.hpp"
+#include <cfloat>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/**
+ * Routeur scatter-gather devant plusieurs face_recognition_server lancés en
+ * mode shard (FACE_SHARD=i/n : l'instance i ne possède que les clients dont
+ * label % n == i).
+ *
+ * - /identify, /identify_batch, /identify_frame : la requête est envoyée à
+ *   tous les shards en parallèle ; pour chaque visage, la réponse du shard
+ *   de plus petite distance ("confidence") est retenue.
+ * - /verify, /enroll, /remove : transmis au seul shard propriétaire du
+ *   client_id.
+ * - /reload : transmis à tous les shards (chacun recharge ses clients) ;
+ *   202 si tous l'ont accepté, 409 si l'un était occupé (rechargement ou
+ *   chargement en cours), 502 si l'un a échoué ou n'a pas répondu.
+ * - /healthz : le routeur lui-même ; /readyz : 200 seulement si le /readyz
+ *   de chaque shard répond 200. /metrics et /cache_stats restent propres à
+ *   chaque shard (à interroger directement).
+ *
+ * Configuration :
+ *   ROUTER_SHARDS=http://localhost:8001,http://localhost:8002  (ordre = i)
+ *   ROUTER_PORT=8000, ROUTER_TIMEOUT_MS=2000
+ *
+ * Un shard qui ne répond pas fait échouer la requête (502) : un résultat
+ * partiel pourrait déclarer inconnu un client connu.
+ */
+
+static struct mg_mgr mgr;
+static vector<string> shards;
+static int timeout_ms = 2000;
+
+// Une requête client en cours, répartie sur un ou plusieurs shards
+struct Fanout {
+    unsigned long client_id;
+    string route;
+    vector<int> status;
+    vector<string> bodies;
+    size_t pending = 0;
+    bool failed = false;
+};
+
+// Connexion vers un shard (fn_data de la connexion, libérée à MG_EV_CLOSE)
+struct ShardCall {
+    shared_ptr<Fanout> fanout;
+    size_t slot;
+    string request;
+    uint64_t deadline;
+    bool done = false;
+};
+
+static struct mg_connection* find_connection(unsigned long id) {
+    for (struct mg_connection* c = mgr.conns; c != NULL; c = c->next) {
+        if (c->id == id) return c;
+    }
+    return NULL;
+}
+
+// "confidence": null (shard vide) : ce shard perd toujours la fusion
+static double item_distance(struct mg_str item) {
+    double d;
+    return mg_json_get_num(item, "$.confidence", &d) ? d : DBL_MAX;
+}
+
+/**
+ * Fusion élément par élément : `path` est le tableau des visages ("$" ou
+ * "$.faces"). Tous les shards voient la même image, donc la même liste ;
+ * à distance égale le premier shard l'emporte.
+ */
+static string merge_items(const vector<string>& bodies, const string& path) {
+    string out;
+    for (size_t i = 0;; i++) {
+        string item_path = path + "[" + to_string(i) + "]";
+        struct mg_str best = mg_str_n(NULL, 0);
+        double best_d = DBL_MAX;
+        for (const string& body : bodies) {
+            struct mg_str item = mg_json_get_tok(mg_str_n(body.data(), body.size()), item_path.c_str());
+            if (item.buf == NULL) continue;
+            double d = item_distance(item);
+            if (best.buf == NULL || d < best_d) {
+                best = item;
+                best_d = d;
+            }
+        }
+        if (best.buf == NULL) break;
+        if (i > 0) out += ", ";
+        out.append(best.buf, best.len);
+    }
+    return out;
+}
+
+// Statut HTTP de chaque shard, dans l'ordre (0 : sans réponse)
+static string shard_statuses(const Fanout& f) {
+    string out;
+    for (size_t i = 0; i < f.status.size(); i++) {
+        if (i > 0) out += ", ";
+        out += to_string(f.status[i]);
+    }
+    return out;
+}
+
+static void complete(Fanout& f) {
+    struct mg_connection* c = find_connection(f.client_id);
+    if (c == NULL) return;  // client parti entre-temps
+
+    const char* json = "Content-Type: application/json\r\n";
+    if (f.route == "/readyz") {
+        bool ready = !f.failed;
+        for (int status : f.status) ready = ready && status == 200;
+        mg_http_reply(c, ready ? 200 : 503, json, "{\"ready\": %s, \"shards\": [%s]}", ready ? "true" : "false",
+                      shard_statuses(f).c_str());
+        return;
+    }
+    if (f.route == "/reload") {
+        int status = f.failed ? 502 : 202;
+        for (int shard : f.status) {
+            if (status == 502 || shard == 202) continue;
+            status = (shard == 409 || shard == 503) ? 409 : 502;
+        }
+        const char* outcome = status == 202 ? "started" : status == 409 ? "busy" : "failed";
+        mg_http_reply(c, status, json, "{\"reload\": \"%s\", \"shards\": [%s]}", outcome,
+                      shard_statuses(f).c_str());
+        return;
+    }
+    if (f.failed) {
+        mg_http_reply(c, 502, json, "{\"error\": \"Shard indisponible\"}");
+        return;
+    }
+    // Erreur de requête (image invalide...) : tous les shards la voient, on relaie la première
+    for (size_t i = 0; i < f.bodies.size(); i++) {
+        if (f.status[i] != 200) {
+            mg_http_reply(c, f.status[i], json, "%s", f.bodies[i].c_str());
+            return;
+        }
+    }
+
+    if (f.route == "/identify_batch") {
+        mg_http_reply(c, 200, json, "[%s]", merge_items(f.bodies, "$").c_str());
+    } else if (f.route == "/identify_frame") {
+        mg_http_reply(c, 200, json, "{\"faces\": [%s]}", merge_items(f.bodies, "$.faces").c_str());
+    } else if (f.route == "/identify") {
+        size_t best = 0;
+        for (size_t i = 1; i < f.bodies.size(); i++) {
+            if (item_distance(mg_str(f.bodies[i].c_str())) < item_distance(mg_str(f.bodies[best].c_str()))) {
+                best = i;
+            }
+        }
+        mg_http_reply(c, 200, json, "%s", f.bodies[best].c_str());
+    } else {
+        mg_http_reply(c, 200, json, "%s", f.bodies[0].c_str());
+    }
+}
+
+static void finish_call(ShardCall* call) {
+    if (call->done) return;
+    call->done = true;
+    if (--call->fanout->pending == 0) complete(*call->fanout);
+}
+
+static void shard_handler(struct mg_connection* c, int ev, void* ev_data) {
+    ShardCall* call = (ShardCall*) c->fn_data;
+
+    if (ev == MG_EV_CONNECT) {
+        mg_send(c, call->request.data(), call->request.size());
+    } else if (ev == MG_EV_HTTP_MSG) {
+        struct mg_http_message* hm = (struct mg_http_message*) ev_data;
+        call->fanout->status[call->slot] = mg_http_status(hm);
+        call->fanout->bodies[call->slot].assign(hm->body.buf, hm->body.len);
+        finish_call(call);
+        c->is_draining = 1;
+    } else if (ev == MG_EV_POLL) {
+        if (!call->done && mg_millis() > call->deadline) c->is_closing = 1;
+    } else if (ev == MG_EV_CLOSE) {
+        if (!call->done) {
+            cerr << "[!] Shard " << shards[call->slot] << " sans réponse" << endl;
+            call->fanout->failed = true;
+            finish_call(call);
+        }
+        delete call;
+    }
+}
+
+// Même requête, réécrite pour le shard (Host, Content-Length, Connection: close)
+static string forward_request(struct mg_http_message* hm, const string& shard_url) {
+    struct mg_str host = mg_url_host(shard_url.c_str());
+    struct mg_str* type = mg_http_get_header(hm, "Content-Type");
+
+    ostringstream req;
+    req << string(hm->method.buf, hm->method.len) << " " << string(hm->uri.buf, hm->uri.len);
+    if (hm->query.len > 0) req << "?" << string(hm->query.buf, hm->query.len);
+    req << " HTTP/1.1\r\nHost: " << string(host.buf, host.len) << "\r\n";
+    if (type != NULL) req << "Content-Type: " << string(type->buf, type->len) << "\r\n";
+    req << "Content-Length: " << hm->body.len << "\r\nConnection: close\r\n\r\n";
+    req << string(hm->body.buf, hm->body.len);
+    return req.str();
+}
+
+// Envoie la requête aux shards `targets` ; la réponse au client part de complete().
+static void scatter(struct mg_connection* c, struct mg_http_message* hm, const vector<size_t>& targets) {
+    shared_ptr<Fanout> fanout = make_shared<Fanout>();
+    fanout->client_id = c->id;
+    fanout->route.assign(hm->uri.buf, hm->uri.len);
+    fanout->status.assign(targets.size(), 0);
+    fanout->bodies.assign(targets.size(), string());
+    fanout->pending = targets.size();
+
+    for (size_t slot = 0; slot < targets.size(); slot++) {
+        const string& url = shards[targets[slot]];
+        ShardCall* call = new ShardCall();
+        call->fanout = fanout;
+        call->slot = slot;
+        call->request = forward_request(hm, url);
+        call->deadline = mg_millis() + timeout_ms;
+        if (mg_http_connect(&mgr, url.c_str(), shard_handler, call) == NULL) {
+            cerr << "[!] Connexion impossible au shard " << url << endl;
+            fanout->failed = true;
+            finish_call(call);
+            delete call;
+        }
+    }
+}
+
+// client_id dans l'URL ou le formulaire (comme face_recognition_server) ; -1 si absent
+static int get_client_id(struct mg_http_message* hm) {
+    char buf[16] = "";
+    if (mg_http_get_var(&hm->query, "client_id", buf, sizeof(buf)) <= 0) {
+        mg_http_get_var(&hm->body, "client_id", buf, sizeof(buf));
+    }
+    char* end = NULL;
+    long id = strtol(buf, &end, 10);
+    return (end != buf && *end == '\0' && id >= 0) ? (int) id : -1;
+}
+
+static void handle_request(struct mg_connection* c, int ev, void* ev_data) {
+    if (ev != MG_EV_HTTP_MSG) return;
+    struct mg_http_message* hm = (struct mg_http_message*) ev_data;
+
+    if (mg_match(hm->uri, mg_str("/identify"), NULL) || mg_match(hm->uri, mg_str("/identify_batch"), NULL) ||
+        mg_match(hm->uri, mg_str("/identify_frame"), NULL) || mg_match(hm->uri, mg_str("/reload"), NULL) ||
+        mg_match(hm->uri, mg_str("/readyz"), NULL)) {
+        vector<size_t> all;
+        for (size_t i = 0; i < shards.size(); i++) all.push_back(i);
+        scatter(c, hm, all);
+    } else if (mg_match(hm->uri, mg_str("/verify"), NULL) || mg_match(hm->uri, mg_str("/enroll"), NULL) ||
+               mg_match(hm->uri, mg_str("/remove"), NULL)) {
+        int label = get_client_id(hm);
+        if (label < 0) {
+            mg_http_reply(c, 400, "", "{\"error\": \"client_id manquant\"}");
+            return;
+        }
+        scatter(c, hm, vector<size_t>(1, label % shards.size()));
+    } else if (mg_match(hm->uri, mg_str("/healthz"), NULL)) {
+        // Vivant : la boucle du routeur répond, shards prêts ou non (voir /readyz)
+        mg_http_reply(c, 200, "Content-Type: application/json\r\n", "{\"status\": \"ok\"}");
+    } else {
+        mg_http_reply(c, 404, "", "{\"error\": \"Route inconnue\"}");
+    }
+}
+
+int main() {
+    stringstream list(env_str("ROUTER_SHARDS", "http://localhost:8001,http://localhost:8002"));
+    for (string url; getline(list, url, ',');) {
+        if (!url.empty()) shards.push_back(url);
+    }
+    if (shards.empty()) {
+        cerr << "Erreur : ROUTER_SHARDS est vide" << endl;
+        return 1;
+    }
+    timeout_ms = env_int("ROUTER_TIMEOUT_MS", 2000);
+
+    mg_mgr_init(&mgr);
+    int port = env_int("ROUTER_PORT", 8000);
+    string listen_url = "http://0.0.0.0:" + to_string(port);
+    if (mg_http_listen(&mgr, listen_url.c_str(), handle_request, NULL) == NULL) {
+        cerr << "Erreur : Impossible de lancer le routeur sur le port " << port << endl;
+        return 1;
+    }
+
+    cout << "--- Routeur de shards actif sur le port " << port << " (" << shards.size() << " shards) ---" << endl;
+    for (size_t i = 0; i < shards.size(); i++) {
+        cout << "  > Shard " << i << "/" << shards.size() << " : " << shards[i] << endl;
+    }
+
+    for (;;) mg_mgr_poll(&mgr, 50);
+
+    mg_mgr_free(&mgr);
+    return 0;
+}
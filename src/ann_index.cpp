@@ -0,0 +1,169 @@
+#include "ann_index.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cfloat>
+#include <cmath>
+#include <thread>
+#include <utility>
+#include "chisqr.hpp"
+
+static const size_t SIG_FACTOR = 16;
+static const size_t SIG_ALIGN_FLOATS = 16;
+// k-moyennes sur un échantillon : ~16 points par liste, quelques itérations
+static const size_t KMEANS_SAMPLES_PER_LIST = 16;
+static const int KMEANS_ITERATIONS = 8;
+
+// f(i) pour i dans [0, n), réparti sur `threads` threads
+template <typename F>
+static void parallel_for(size_t n, size_t threads, F f) {
+    threads = std::max<size_t>(1, std::min(threads, n));
+    std::atomic<size_t> next(0);
+    auto run = [&]() {
+        for (size_t i; (i = next++) < n;) f(i);
+    };
+    std::vector<std::thread> pool;
+    for (size_t t = 1; t < threads; t++) pool.emplace_back(run);
+    run();
+    for (auto& t : pool) t.join();
+}
+
+IvfIndex::IvfIndex(size_t dim, const AnnParams& params)
+    : dim_(dim),
+      sig_dim_((dim + SIG_FACTOR - 1) / SIG_FACTOR),
+      sig_stride_((sig_dim_ + SIG_ALIGN_FLOATS - 1) / SIG_ALIGN_FLOATS * SIG_ALIGN_FLOATS),
+      params_(params) {}
+
+void IvfIndex::coarsen(const float* hist, float* sig) const {
+    std::fill(sig, sig + sig_stride_, 0.0f);
+    for (size_t i = 0; i < dim_; i++) sig[i / SIG_FACTOR] += hist[i];
+}
+
+size_t IvfIndex::nearest_list(const float* sig) const {
+    chisqr_fn dist = chisqr_kernel();
+    size_t best = 0;
+    double best_d = DBL_MAX;
+    for (size_t k = 0; k < rows_.size(); k++) {
+        double d = dist(sig, &centroids_[k * sig_stride_], sig_stride_);
+        if (d < best_d) {
+            best_d = d;
+            best = k;
+        }
+    }
+    return best;
+}
+
+void IvfIndex::build(const LbphMatcher& gallery, size_t threads) {
+    size_t n = gallery.size();
+    size_t k = std::max<size_t>(1, std::min(n, (size_t) std::lround(std::sqrt((double) n))));
+
+    AlignedFloats sigs(n * sig_stride_);
+    std::vector<float> row(dim_);
+    for (size_t i = 0; i < n; i++) {
+        gallery.copy_histogram(i, row.data());
+        coarsen(row.data(), &sigs[i * sig_stride_]);
+    }
+
+    // Échantillon régulier, centres initiaux répartis dans l'échantillon
+    size_t step = std::max<size_t>(1, n / (k * KMEANS_SAMPLES_PER_LIST));
+    std::vector<size_t> sample;
+    for (size_t i = 0; i < n; i += step) sample.push_back(i);
+
+    rows_.assign(k, std::vector<uint32_t>());
+    centroids_.assign(k * sig_stride_, 0.0f);
+    for (size_t c = 0; c < k; c++) {
+        const float* s = &sigs[sample[c * sample.size() / k] * sig_stride_];
+        std::copy(s, s + sig_stride_, &centroids_[c * sig_stride_]);
+    }
+
+    std::vector<size_t> assign(n);
+    for (int it = 0; it < KMEANS_ITERATIONS; it++) {
+        parallel_for(sample.size(), threads, [&](size_t j) {
+            assign[j] = nearest_list(&sigs[sample[j] * sig_stride_]);
+        });
+
+        // Moyenne des membres ; une liste vide garde son centre
+        std::vector<double> sum(k * sig_stride_, 0.0);
+        std::vector<size_t> count(k, 0);
+        for (size_t j = 0; j < sample.size(); j++) {
+            const float* s = &sigs[sample[j] * sig_stride_];
+            double* acc = &sum[assign[j] * sig_stride_];
+            for (size_t d = 0; d < sig_dim_; d++) acc[d] += s[d];
+            count[assign[j]]++;
+        }
+        for (size_t c = 0; c < k; c++) {
+            if (count[c] == 0) continue;
+            for (size_t d = 0; d < sig_dim_; d++) {
+                centroids_[c * sig_stride_ + d] = (float) (sum[c * sig_stride_ + d] / count[c]);
+            }
+        }
+    }
+
+    parallel_for(n, threads, [&](size_t i) { assign[i] = nearest_list(&sigs[i * sig_stride_]); });
+
+    sigs_.assign(k, AlignedFloats());
+    for (size_t i = 0; i < n; i++) {
+        size_t c = assign[i];
+        rows_[c].push_back((uint32_t) i);
+        sigs_[c].insert(sigs_[c].end(), &sigs[i * sig_stride_], &sigs[i * sig_stride_] + sig_stride_);
+    }
+}
+
+void IvfIndex::add(const float* hist, uint32_t row) {
+    AlignedFloats sig(sig_stride_);
+    coarsen(hist, sig.data());
+    size_t c = nearest_list(sig.data());
+    rows_[c].push_back(row);
+    sigs_[c].insert(sigs_[c].end(), sig.begin(), sig.end());
+}
+
+void IvfIndex::remap(const std::vector<char>& keep) {
+    std::vector<uint32_t> new_row(keep.size());
+    uint32_t kept = 0;
+    for (size_t i = 0; i < keep.size(); i++) new_row[i] = keep[i] ? kept++ : UINT32_MAX;
+
+    for (size_t c = 0; c < rows_.size(); c++) {
+        std::vector<uint32_t>& rows = rows_[c];
+        AlignedFloats& sigs = sigs_[c];
+        size_t out = 0;
+        for (size_t j = 0; j < rows.size(); j++) {
+            if (new_row[rows[j]] == UINT32_MAX) continue;
+            rows[out] = new_row[rows[j]];
+            if (out != j) {
+                std::copy(&sigs[j * sig_stride_], &sigs[j * sig_stride_] + sig_stride_, &sigs[out * sig_stride_]);
+            }
+            out++;
+        }
+        rows.resize(out);
+        sigs.resize(out * sig_stride_);
+    }
+}
+
+void IvfIndex::candidates(const float* query, std::vector<uint32_t>& rows) const {
+    chisqr_fn dist = chisqr_kernel();
+    AlignedFloats sig(sig_stride_);
+    coarsen(query, sig.data());
+
+    std::vector<std::pair<double, size_t>> lists(rows_.size());
+    for (size_t c = 0; c < rows_.size(); c++) {
+        lists[c] = std::make_pair(dist(sig.data(), &centroids_[c * sig_stride_], sig_stride_), c);
+    }
+    size_t probes = std::min(std::max<size_t>(1, params_.probes), lists.size());
+    std::partial_sort(lists.begin(), lists.begin() + probes, lists.end());
+
+    std::vector<std::pair<double, uint32_t>> scored;
+    for (size_t p = 0; p < probes; p++) {
+        size_t c = lists[p].second;
+        const float* s = sigs_[c].data();
+        for (size_t j = 0; j < rows_[c].size(); j++, s += sig_stride_) {
+            scored.push_back(std::make_pair(dist(sig.data(), s, sig_stride_), rows_[c][j]));
+        }
+    }
+
+    size_t keep = std::min(std::max<size_t>(1, params_.rerank), scored.size());
+    std::partial_sort(scored.begin(), scored.begin() + keep, scored.end());
+
+    rows.resize(keep);
+    for (size_t j = 0; j < keep; j++) rows[j] = scored[j].second;
+    std::sort(rows.begin(), rows.end());
+}
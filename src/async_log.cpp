@@ -0,0 +1,230 @@
+#include "async_log.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+
+const size_t RING_SLOTS = 512;  // puissance de 2
+const size_t LINE_BYTES = 240;  // texte tronqué au-delà
+const std::chrono::milliseconds FLUSH_PERIOD(10);
+
+struct LogSlot {
+    uint64_t seq;
+    LogLevel level;
+    char text[LINE_BYTES];
+};
+
+// Anneau d'un thread : seul ce thread avance head, seul l'écrivain avance tail.
+struct LogRing {
+    LogSlot slots[RING_SLOTS];
+    std::atomic<size_t> head{0};
+    std::atomic<size_t> tail{0};
+    std::atomic<uint64_t> overflow{0};  // anneau plein
+    std::atomic<uint64_t> limited{0};   // débit dépassé
+    std::atomic<bool> closed{false};    // thread terminé
+
+    // Seau à jetons, propre au thread producteur
+    double tokens = -1.0;
+    std::chrono::steady_clock::time_point refill;
+};
+
+std::atomic<int> min_level(LOG_INFO);
+std::atomic<int> rate_limit(0);
+std::atomic<bool> running(false);
+std::atomic<bool> stopping(false);
+std::atomic<uint64_t> next_seq(0);
+
+std::mutex registry_mutex;  // enregistrement d'un nouveau thread seulement
+std::vector<std::shared_ptr<LogRing>> rings;
+std::mutex drain_mutex;     // un seul consommateur à la fois
+std::thread writer;
+
+// Anneau du thread courant, créé à sa première ligne
+struct RingHandle {
+    std::shared_ptr<LogRing> ring;
+    ~RingHandle() {
+        if (ring) ring->closed.store(true, std::memory_order_release);
+    }
+};
+
+LogRing& thread_ring() {
+    thread_local RingHandle handle;
+    if (!handle.ring) {
+        handle.ring = std::make_shared<LogRing>();
+        std::lock_guard<std::mutex> lock(registry_mutex);
+        rings.push_back(handle.ring);
+    }
+    return *handle.ring;
+}
+
+FILE* stream_of(LogLevel level) {
+    return level >= LOG_WARN ? stderr : stdout;
+}
+
+bool take_token(LogRing& ring) {
+    int rate = rate_limit.load(std::memory_order_relaxed);
+    if (rate <= 0) return true;
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    if (ring.tokens < 0.0) {
+        ring.tokens = rate;
+    } else {
+        double elapsed = std::chrono::duration<double>(now - ring.refill).count();
+        ring.tokens = std::min<double>(rate, ring.tokens + elapsed * rate);
+    }
+    ring.refill = now;
+    if (ring.tokens < 1.0) return false;
+    ring.tokens -= 1.0;
+    return true;
+}
+
+// Vide tous les anneaux, lignes remises dans l'ordre d'émission
+void drain() {
+    std::lock_guard<std::mutex> drain_lock(drain_mutex);
+    std::vector<std::shared_ptr<LogRing>> snapshot;
+    {
+        std::lock_guard<std::mutex> lock(registry_mutex);
+        snapshot = rings;
+    }
+
+    struct Pending {
+        uint64_t seq;
+        const LogSlot* slot;
+    };
+    std::vector<Pending> pending;
+    std::vector<size_t> heads(snapshot.size());
+    uint64_t overflow = 0, limited = 0;
+    for (size_t r = 0; r < snapshot.size(); r++) {
+        LogRing& ring = *snapshot[r];
+        size_t tail = ring.tail.load(std::memory_order_relaxed);
+        heads[r] = ring.head.load(std::memory_order_acquire);
+        for (size_t i = tail; i != heads[r]; i++) {
+            const LogSlot& slot = ring.slots[i % RING_SLOTS];
+            pending.push_back({slot.seq, &slot});
+        }
+        overflow += ring.overflow.exchange(0, std::memory_order_relaxed);
+        limited += ring.limited.exchange(0, std::memory_order_relaxed);
+    }
+    if (pending.empty() && overflow == 0 && limited == 0) return;
+
+    std::sort(pending.begin(), pending.end(),
+              [](const Pending& a, const Pending& b) { return a.seq < b.seq; });
+    bool out = false, err = false;
+    for (const Pending& p : pending) {
+        FILE* f = stream_of(p.slot->level);
+        fputs(p.slot->text, f);
+        fputc('\n', f);
+        (f == stderr ? err : out) = true;
+    }
+    if (overflow > 0 || limited > 0) {
+        fprintf(stderr, "[!] Journal : %llu ligne(s) perdue(s) (file pleine), %llu écartée(s) (débit)\n",
+                (unsigned long long) overflow, (unsigned long long) limited);
+        err = true;
+    }
+    if (out) fflush(stdout);
+    if (err) fflush(stderr);
+
+    // Les emplacements ne sont rendus qu'une fois écrits
+    for (size_t r = 0; r < snapshot.size(); r++) {
+        snapshot[r]->tail.store(heads[r], std::memory_order_release);
+    }
+
+    // Threads terminés et anneau vide : on oublie l'anneau
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    rings.erase(std::remove_if(rings.begin(), rings.end(),
+                               [](const std::shared_ptr<LogRing>& ring) {
+                                   return ring->closed.load(std::memory_order_acquire) &&
+                                          ring->tail.load(std::memory_order_relaxed) ==
+                                              ring->head.load(std::memory_order_acquire);
+                               }),
+                rings.end());
+}
+
+void log_stop() {
+    if (!running.exchange(false)) return;
+    stopping = true;
+    if (writer.joinable()) writer.join();
+    drain();
+}
+
+}  // namespace
+
+bool parse_log_level(const std::string& name, LogLevel& level) {
+    if (name == "debug") level = LOG_DEBUG;
+    else if (name == "info") level = LOG_INFO;
+    else if (name == "warn") level = LOG_WARN;
+    else if (name == "error") level = LOG_ERROR;
+    else return false;
+    return true;
+}
+
+void log_start(const LogConfig& config) {
+    min_level = config.level;
+    rate_limit = config.rate;
+    if (running.exchange(true)) return;
+    fflush(stdout);
+    fflush(stderr);
+    stopping = false;
+    writer = std::thread([]() {
+        while (!stopping.load(std::memory_order_relaxed)) {
+            std::this_thread::sleep_for(FLUSH_PERIOD);
+            drain();
+        }
+    });
+    std::atexit(log_stop);
+}
+
+void log_flush() {
+    if (running.load(std::memory_order_acquire)) drain();
+}
+
+bool log_enabled(LogLevel level) {
+    return level >= min_level.load(std::memory_order_relaxed);
+}
+
+void log_vwrite(LogLevel level, const char* fmt, va_list args) {
+    if (!log_enabled(level)) return;
+
+    if (!running.load(std::memory_order_acquire)) {
+        FILE* f = stream_of(level);
+        vfprintf(f, fmt, args);
+        fputc('\n', f);
+        fflush(f);
+        return;
+    }
+
+    LogRing& ring = thread_ring();
+    if (level < LOG_WARN && !take_token(ring)) {
+        ring.limited.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    size_t head = ring.head.load(std::memory_order_relaxed);
+    if (head - ring.tail.load(std::memory_order_acquire) == RING_SLOTS) {
+        ring.overflow.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    LogSlot& slot = ring.slots[head % RING_SLOTS];
+    slot.seq = next_seq.fetch_add(1, std::memory_order_relaxed);
+    slot.level = level;
+    vsnprintf(slot.text, LINE_BYTES, fmt, args);
+    ring.head.store(head + 1, std::memory_order_release);
+}
+
+#define LOG_AT(level)                 \
+    va_list args;                     \
+    va_start(args, fmt);              \
+    log_vwrite(level, fmt, args);     \
+    va_end(args)
+
+void log_debug(const char* fmt, ...) { LOG_AT(LOG_DEBUG); }
+void log_info(const char* fmt, ...) { LOG_AT(LOG_INFO); }
+void log_warn(const char* fmt, ...) { LOG_AT(LOG_WARN); }
+void log_error(const char* fmt, ...) { LOG_AT(LOG_ERROR); }
@@ -0,0 +1,100 @@
+#include "async_reply.hpp"
+#include "async_log.hpp"
+
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+namespace {
+
+struct PendingReply {
+    unsigned long conn_id;
+    int status;
+    std::string headers;
+    std::string body;
+};
+
+// Réponses prêtes, par numéro de tâche (seul le numéro passe par mg_wakeup)
+std::mutex pending_mutex;
+std::map<unsigned long, PendingReply> pending;
+unsigned long next_job = 0;
+
+void send_reply(struct mg_connection* c, const PendingReply& r) {
+    mg_http_reply(c, r.status, r.headers.c_str(), "%.*s", (int) r.body.size(), r.body.data());
+}
+
+}  // namespace
+
+bool async_reply(struct mg_mgr* mgr, unsigned long conn_id, int status,
+                 const char* headers, const char* fmt, ...) {
+    PendingReply reply{conn_id, status, headers ? headers : "", std::string()};
+
+    va_list ap, ap2;
+    va_start(ap, fmt);
+    va_copy(ap2, ap);
+    int n = vsnprintf(NULL, 0, fmt, ap);
+    va_end(ap);
+    if (n > 0) {
+        reply.body.resize((size_t) n + 1);
+        vsnprintf(&reply.body[0], (size_t) n + 1, fmt, ap2);
+        reply.body.pop_back();  // NUL final de vsnprintf
+    }
+    va_end(ap2);
+
+    unsigned long job;
+    {
+        std::lock_guard<std::mutex> lock(pending_mutex);
+        job = ++next_job;
+        pending.emplace(job, std::move(reply));
+    }
+    // Echec : la réponse reste dans la table, flush_async_replies() l'enverra
+    if (!mg_wakeup(mgr, conn_id, &job, sizeof(job))) {
+        log_warn("[!] mg_wakeup a échoué (connexion %lu) : réponse différée", conn_id);
+        return false;
+    }
+    return true;
+}
+
+void send_async_reply(struct mg_connection* c, const struct mg_str* data) {
+    if (data->len != sizeof(unsigned long)) return;
+    unsigned long job;
+    memcpy(&job, data->buf, sizeof(job));
+
+    PendingReply reply;
+    {
+        std::lock_guard<std::mutex> lock(pending_mutex);
+        auto it = pending.find(job);
+        // Déjà envoyée par flush_async_replies(), ou autre connexion
+        if (it == pending.end() || it->second.conn_id != c->id) return;
+        reply = std::move(it->second);
+        pending.erase(it);
+    }
+    send_reply(c, reply);
+}
+
+void flush_async_replies(struct mg_mgr* mgr) {
+    std::vector<PendingReply> ready;
+    {
+        std::lock_guard<std::mutex> lock(pending_mutex);
+        if (pending.empty()) return;
+        std::unordered_set<unsigned long> live;
+        for (struct mg_connection* c = mgr->conns; c != NULL; c = c->next) live.insert(c->id);
+        for (auto it = pending.begin(); it != pending.end(); it = pending.erase(it)) {
+            // Client parti : la réponse est oubliée
+            if (live.count(it->second.conn_id)) ready.push_back(std::move(it->second));
+        }
+    }
+    for (const PendingReply& r : ready) {
+        for (struct mg_connection* c = mgr->conns; c != NULL; c = c->next) {
+            if (c->id == r.conn_id) {
+                send_reply(c, r);
+                break;
+            }
+        }
+    }
+}
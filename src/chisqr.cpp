@@ -0,0 +1,310 @@
+#include "chisqr.hpp"
+
+#include <cfloat>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define CHISQR_X86 1
+#endif
+
+// Pas de contraction en FMA dans ce fichier : q * scale doit être arrondi
+// en float avant a-b et a+b, sans quoi un noyau u16/u8 ne rendrait plus,
+// au bit près, la distance du noyau float sur la ligne déquantifiée.
+#pragma GCC optimize("fp-contract=off")
+
+// Fréquence du test d'abandon (en floats) : assez rare pour ne pas ralentir
+// la boucle, assez fréquent pour arrêter tôt un candidat perdu.
+static const size_t BOUND_CHECK_FLOATS = 256;
+
+// Valeur j de la ligne, en float (déquantifiée pour les lignes entières)
+static inline float row_value(const float* h, float, size_t j) { return h[j]; }
+template <typename Q>
+static inline float row_value(const Q* q, float scale, size_t j) { return (float) q[j] * scale; }
+
+/**
+ * Somme brute des termes (boucle de compareHist), sans le facteur 2.
+ * Avec `bound` : arrêt dès que 2 * somme partielle dépasse bound ; les
+ * termes étant positifs, le résultat final ne peut alors que le dépasser.
+ */
+template <typename R>
+static inline double chisqr_sum(const float* h1, const R* h2, float scale, size_t n,
+                                double bound = DBL_MAX) {
+    double result = 0.0;
+    for (size_t j = 0; j < n; j++) {
+        float y = row_value(h2, scale, j);
+        double a = h1[j] - y;
+        double b = h1[j] + y;
+        if (std::fabs(b) > DBL_EPSILON) result += a * a / b;
+        if (bound < DBL_MAX && (j + 1) % BOUND_CHECK_FLOATS == 0 && 2.0 * result > bound) break;
+    }
+    return result;
+}
+
+template <typename R>
+static double chisqr_scalar(const float* h1, const R* h2, float scale, size_t n, double bound) {
+    return 2.0 * chisqr_sum(h1, h2, scale, n, bound);
+}
+
+#ifdef CHISQR_X86
+
+// Un pas de 4 floats : a-b et a+b en float, quotient accumulé en double.
+static inline void chisqr_step_sse2(__m128 x, __m128 y, __m128d& acc0, __m128d& acc1) {
+    const __m128d eps = _mm_set1_pd(DBL_EPSILON);
+    const __m128d sign = _mm_set1_pd(-0.0);
+    __m128 d = _mm_sub_ps(x, y);
+    __m128 s = _mm_add_ps(x, y);
+
+    __m128d a0 = _mm_cvtps_pd(d), a1 = _mm_cvtps_pd(_mm_movehl_ps(d, d));
+    __m128d b0 = _mm_cvtps_pd(s), b1 = _mm_cvtps_pd(_mm_movehl_ps(s, s));
+    __m128d m0 = _mm_cmpgt_pd(_mm_andnot_pd(sign, b0), eps);
+    __m128d m1 = _mm_cmpgt_pd(_mm_andnot_pd(sign, b1), eps);
+    acc0 = _mm_add_pd(acc0, _mm_and_pd(m0, _mm_div_pd(_mm_mul_pd(a0, a0), b0)));
+    acc1 = _mm_add_pd(acc1, _mm_and_pd(m1, _mm_div_pd(_mm_mul_pd(a1, a1), b1)));
+}
+
+static inline double chisqr_lanes_sse2(__m128d acc0, __m128d acc1) {
+    double lanes[2];
+    _mm_storeu_pd(lanes, _mm_add_pd(acc0, acc1));
+    return lanes[0] + lanes[1];
+}
+
+// 4 valeurs de la ligne en float
+static inline __m128 load4_sse2(const float* h, size_t j, __m128) {
+    return _mm_loadu_ps(h + j);
+}
+static inline __m128 load4_sse2(const uint16_t* q, size_t j, __m128 scale) {
+    __m128i v = _mm_unpacklo_epi16(_mm_loadl_epi64((const __m128i*) (q + j)), _mm_setzero_si128());
+    return _mm_mul_ps(_mm_cvtepi32_ps(v), scale);
+}
+static inline __m128 load4_sse2(const uint8_t* q, size_t j, __m128 scale) {
+    uint32_t bytes;
+    memcpy(&bytes, q + j, sizeof(bytes));
+    const __m128i zero = _mm_setzero_si128();
+    __m128i v = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128((int) bytes), zero), zero);
+    return _mm_mul_ps(_mm_cvtepi32_ps(v), scale);
+}
+
+template <typename R>
+static double chisqr_sse2(const float* h1, const R* h2, float scale, size_t n, double bound) {
+    const __m128 sc = _mm_set1_ps(scale);
+    __m128d acc0 = _mm_setzero_pd(), acc1 = _mm_setzero_pd();
+    size_t j = 0;
+    for (; j + 4 <= n; j += 4) {
+        chisqr_step_sse2(_mm_loadu_ps(h1 + j), load4_sse2(h2, j, sc), acc0, acc1);
+        if (bound < DBL_MAX && (j + 4) % BOUND_CHECK_FLOATS == 0 &&
+            2.0 * chisqr_lanes_sse2(acc0, acc1) > bound) {
+            return 2.0 * chisqr_lanes_sse2(acc0, acc1);
+        }
+    }
+    return 2.0 * (chisqr_lanes_sse2(acc0, acc1) + chisqr_sum(h1 + j, h2 + j, scale, n - j));
+}
+
+__attribute__((target("avx2")))
+static inline void chisqr_step_avx2(__m256 x, __m256 y, __m256d& acc0, __m256d& acc1) {
+    const __m256d eps = _mm256_set1_pd(DBL_EPSILON);
+    const __m256d sign = _mm256_set1_pd(-0.0);
+    __m256 d = _mm256_sub_ps(x, y);
+    __m256 s = _mm256_add_ps(x, y);
+
+    __m256d a0 = _mm256_cvtps_pd(_mm256_castps256_ps128(d));
+    __m256d a1 = _mm256_cvtps_pd(_mm256_extractf128_ps(d, 1));
+    __m256d b0 = _mm256_cvtps_pd(_mm256_castps256_ps128(s));
+    __m256d b1 = _mm256_cvtps_pd(_mm256_extractf128_ps(s, 1));
+    __m256d m0 = _mm256_cmp_pd(_mm256_andnot_pd(sign, b0), eps, _CMP_GT_OQ);
+    __m256d m1 = _mm256_cmp_pd(_mm256_andnot_pd(sign, b1), eps, _CMP_GT_OQ);
+    acc0 = _mm256_add_pd(acc0, _mm256_and_pd(m0, _mm256_div_pd(_mm256_mul_pd(a0, a0), b0)));
+    acc1 = _mm256_add_pd(acc1, _mm256_and_pd(m1, _mm256_div_pd(_mm256_mul_pd(a1, a1), b1)));
+}
+
+__attribute__((target("avx2")))
+static inline double chisqr_lanes_avx2(__m256d acc0, __m256d acc1) {
+    double lanes[4];
+    _mm256_storeu_pd(lanes, _mm256_add_pd(acc0, acc1));
+    return lanes[0] + lanes[1] + lanes[2] + lanes[3];
+}
+
+__attribute__((target("avx2")))
+static inline __m256 load8_avx2(const float* h, size_t j, __m256) {
+    return _mm256_loadu_ps(h + j);
+}
+__attribute__((target("avx2")))
+static inline __m256 load8_avx2(const uint16_t* q, size_t j, __m256 scale) {
+    __m256i v = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*) (q + j)));
+    return _mm256_mul_ps(_mm256_cvtepi32_ps(v), scale);
+}
+__attribute__((target("avx2")))
+static inline __m256 load8_avx2(const uint8_t* q, size_t j, __m256 scale) {
+    __m256i v = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*) (q + j)));
+    return _mm256_mul_ps(_mm256_cvtepi32_ps(v), scale);
+}
+
+template <typename R>
+__attribute__((target("avx2")))
+static double chisqr_avx2(const float* h1, const R* h2, float scale, size_t n, double bound) {
+    const __m256 sc = _mm256_set1_ps(scale);
+    __m256d acc0 = _mm256_setzero_pd(), acc1 = _mm256_setzero_pd();
+    size_t j = 0;
+    for (; j + 8 <= n; j += 8) {
+        chisqr_step_avx2(_mm256_loadu_ps(h1 + j), load8_avx2(h2, j, sc), acc0, acc1);
+        if (bound < DBL_MAX && (j + 8) % BOUND_CHECK_FLOATS == 0 &&
+            2.0 * chisqr_lanes_avx2(acc0, acc1) > bound) {
+            return 2.0 * chisqr_lanes_avx2(acc0, acc1);
+        }
+    }
+    return 2.0 * (chisqr_lanes_avx2(acc0, acc1) + chisqr_sum(h1 + j, h2 + j, scale, n - j));
+}
+
+// Les formes non masquées de ces intrinsèques (conversions, extractions,
+// réduction) partent chez GCC d'un registre "undefined", d'où des
+// -Wmaybe-uninitialized : on passe par les formes maskz, source à zéro,
+// masque plein (même instruction, rien de non initialisé).
+static const __mmask8 ALL8 = 0xFF;
+static const __mmask16 ALL16 = 0xFFFF;
+
+// Moitié basse (half = 0) ou haute (1) de 16 floats, en 8 doubles
+__attribute__((target("avx512f")))
+static inline __m512d half_pd_avx512(__m512 v, int half) {
+    __m256d h = half == 0 ? _mm512_maskz_extractf64x4_pd(ALL8, _mm512_castps_pd(v), 0)
+                          : _mm512_maskz_extractf64x4_pd(ALL8, _mm512_castps_pd(v), 1);
+    return _mm512_maskz_cvtps_pd(ALL8, _mm256_castpd_ps(h));
+}
+
+// Somme des 8 voies, dans l'ordre de _mm512_reduce_add_pd
+__attribute__((target("avx512f")))
+static inline double reduce_add_avx512(__m512d v) {
+    __m256d t = _mm256_add_pd(_mm512_maskz_extractf64x4_pd(ALL8, v, 1), _mm512_maskz_extractf64x4_pd(ALL8, v, 0));
+    __m128d u = _mm_add_pd(_mm256_extractf128_pd(t, 1), _mm256_castpd256_pd128(t));
+    return _mm_cvtsd_f64(u) + _mm_cvtsd_f64(_mm_unpackhi_pd(u, u));
+}
+
+__attribute__((target("avx512f")))
+static inline void chisqr_step_avx512(__m512 x, __m512 y, __m512d& acc0, __m512d& acc1) {
+    const __m512d eps = _mm512_set1_pd(DBL_EPSILON);
+    __m512 d = _mm512_sub_ps(x, y);
+    __m512 s = _mm512_add_ps(x, y);
+
+    __m512d a0 = half_pd_avx512(d, 0), a1 = half_pd_avx512(d, 1);
+    __m512d b0 = half_pd_avx512(s, 0), b1 = half_pd_avx512(s, 1);
+    __mmask8 m0 = _mm512_cmp_pd_mask(_mm512_abs_pd(b0), eps, _CMP_GT_OQ);
+    __mmask8 m1 = _mm512_cmp_pd_mask(_mm512_abs_pd(b1), eps, _CMP_GT_OQ);
+    acc0 = _mm512_mask_add_pd(acc0, m0, acc0, _mm512_div_pd(_mm512_mul_pd(a0, a0), b0));
+    acc1 = _mm512_mask_add_pd(acc1, m1, acc1, _mm512_div_pd(_mm512_mul_pd(a1, a1), b1));
+}
+
+__attribute__((target("avx512f")))
+static inline __m512 load16_avx512(const float* h, size_t j, __m512) {
+    return _mm512_loadu_ps(h + j);
+}
+__attribute__((target("avx512f")))
+static inline __m512 load16_avx512(const uint16_t* q, size_t j, __m512 scale) {
+    __m512i v = _mm512_maskz_cvtepu16_epi32(ALL16, _mm256_loadu_si256((const __m256i*) (q + j)));
+    return _mm512_mul_ps(_mm512_maskz_cvtepi32_ps(ALL16, v), scale);
+}
+__attribute__((target("avx512f")))
+static inline __m512 load16_avx512(const uint8_t* q, size_t j, __m512 scale) {
+    __m512i v = _mm512_maskz_cvtepu8_epi32(ALL16, _mm_loadu_si128((const __m128i*) (q + j)));
+    return _mm512_mul_ps(_mm512_maskz_cvtepi32_ps(ALL16, v), scale);
+}
+
+template <typename R>
+__attribute__((target("avx512f")))
+static double chisqr_avx512(const float* h1, const R* h2, float scale, size_t n, double bound) {
+    const __m512 sc = _mm512_set1_ps(scale);
+    __m512d acc0 = _mm512_setzero_pd(), acc1 = _mm512_setzero_pd();
+    size_t j = 0;
+    for (; j + 16 <= n; j += 16) {
+        chisqr_step_avx512(_mm512_loadu_ps(h1 + j), load16_avx512(h2, j, sc), acc0, acc1);
+        if (bound < DBL_MAX && (j + 16) % BOUND_CHECK_FLOATS == 0 &&
+            2.0 * reduce_add_avx512(_mm512_add_pd(acc0, acc1)) > bound) {
+            return 2.0 * reduce_add_avx512(_mm512_add_pd(acc0, acc1));
+        }
+    }
+    double result = reduce_add_avx512(_mm512_add_pd(acc0, acc1));
+    return 2.0 * (result + chisqr_sum(h1 + j, h2 + j, scale, n - j));
+}
+
+#endif
+
+// Points d'entrée d'un jeu d'instructions : float, u16, u8, avec et sans borne
+#define CHISQR_ENTRY_POINTS(isa)                                                                  \
+    static double chisqr_f32_##isa(const float* a, const float* b, size_t n) {                     \
+        return chisqr_##isa(a, b, 1.0f, n, DBL_MAX);                                               \
+    }                                                                                              \
+    static double chisqr_u16_##isa(const float* a, const uint16_t* q, float s, size_t n) {         \
+        return chisqr_##isa(a, q, s, n, DBL_MAX);                                                  \
+    }                                                                                              \
+    static double chisqr_u8_##isa(const float* a, const uint8_t* q, float s, size_t n) {           \
+        return chisqr_##isa(a, q, s, n, DBL_MAX);                                                  \
+    }                                                                                              \
+    static double chisqr_f32_bounded_##isa(const float* a, const float* b, size_t n, double bound) { \
+        return chisqr_##isa(a, b, 1.0f, n, bound);                                                 \
+    }                                                                                              \
+    static double chisqr_u16_bounded_##isa(const float* a, const uint16_t* q, float s, size_t n,   \
+                                           double bound) {                                         \
+        return chisqr_##isa(a, q, s, n, bound);                                                    \
+    }                                                                                              \
+    static double chisqr_u8_bounded_##isa(const float* a, const uint8_t* q, float s, size_t n,     \
+                                          double bound) {                                          \
+        return chisqr_##isa(a, q, s, n, bound);                                                    \
+    }
+
+CHISQR_ENTRY_POINTS(scalar)
+#ifdef CHISQR_X86
+CHISQR_ENTRY_POINTS(sse2)
+CHISQR_ENTRY_POINTS(avx2)
+CHISQR_ENTRY_POINTS(avx512)
+#endif
+
+#define CHISQR_KERNELS(isa)                                                                   \
+    {chisqr_f32_##isa, chisqr_u16_##isa, chisqr_u8_##isa,                                     \
+     chisqr_f32_bounded_##isa, chisqr_u16_bounded_##isa, chisqr_u8_bounded_##isa, #isa}
+
+static KernelSet select_kernel() {
+    const char* forced = getenv("LBPH_KERNEL");
+    bool force = forced != NULL && *forced != '\0';
+    const KernelSet scalar = CHISQR_KERNELS(scalar);
+#ifdef CHISQR_X86
+    const KernelSet sse2 = CHISQR_KERNELS(sse2);
+    const KernelSet avx2 = CHISQR_KERNELS(avx2);
+    const KernelSet avx512 = CHISQR_KERNELS(avx512);
+    __builtin_cpu_init();
+    bool has_avx512 = __builtin_cpu_supports("avx512f");
+    bool has_avx2 = __builtin_cpu_supports("avx2");
+    if (force) {
+        if (strcmp(forced, "avx512") == 0 && has_avx512) return avx512;
+        if (strcmp(forced, "avx2") == 0 && has_avx2) return avx2;
+        if (strcmp(forced, "sse2") == 0) return sse2;
+        if (strcmp(forced, "scalar") == 0) return scalar;
+    }
+    if (has_avx512) return avx512;
+    if (has_avx2) return avx2;
+    return sse2;
+#else
+    (void) force;
+    return scalar;
+#endif
+}
+
+const KernelSet& chisqr_kernels() {
+    static const KernelSet kernels = select_kernel();
+    return kernels;
+}
+
+chisqr_fn chisqr_kernel() {
+    return chisqr_kernels().f32;
+}
+
+chisqr_u16_fn chisqr_u16_kernel() {
+    return chisqr_kernels().u16;
+}
+
+chisqr_u8_fn chisqr_u8_kernel() {
+    return chisqr_kernels().u8;
+}
+
+const char* chisqr_kernel_name() {
+    return chisqr_kernels().name;
+}
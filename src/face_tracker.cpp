@@ -0,0 +1,123 @@
+#include "face_tracker.hpp"
+#include <algorithm>
+#include <cmath>
+
+static double iou(const cv::Rect& a, const cv::Rect& b) {
+    double inter = (a & b).area();
+    double uni = a.area() + b.area() - inter;
+    return uni > 0 ? inter / uni : 0.0;
+}
+
+// Centres distants de moins d'une demi-largeur : visage qui a bougé vite
+static bool centroid_close(const cv::Rect& a, const cv::Rect& b) {
+    double dx = (a.x + a.width / 2.0) - (b.x + b.width / 2.0);
+    double dy = (a.y + a.height / 2.0) - (b.y + b.height / 2.0);
+    double r = std::min(a.width, b.width) / 2.0;
+    return dx * dx + dy * dy < r * r;
+}
+
+FaceTracker::FaceTracker(double min_iou, int reverify_every, double threshold, double margin,
+                         int max_age_ms)
+    : min_iou_(min_iou), reverify_every_(std::max(1, reverify_every)),
+      threshold_(threshold), margin_(margin), max_age_(max_age_ms) {}
+
+bool FaceTracker::needs_identify(const Track& t) const {
+    if (!t.verified) return true;
+    if (t.frames_since_verify >= reverify_every_) return true;
+    return std::fabs(t.confidence - threshold_) < margin_;
+}
+
+void FaceTracker::expire(Clock::time_point now) {
+    for (auto it = streams_.begin(); it != streams_.end();) {
+        std::vector<Track>& tracks = it->second;
+        tracks.erase(std::remove_if(tracks.begin(), tracks.end(),
+                                    [&](const Track& t) { return now - t.last_seen > max_age_; }),
+                     tracks.end());
+        if (tracks.empty()) {
+            it = streams_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+std::vector<FaceTracker::Match> FaceTracker::associate(const std::string& stream,
+                                                       const std::vector<cv::Rect>& boxes) {
+    Clock::time_point now = Clock::now();
+    std::lock_guard<std::mutex> lock(mutex_);
+    expire(now);
+    std::vector<Track>& tracks = streams_[stream];
+
+    // Appariement glouton : meilleurs recouvrements d'abord (quelques visages par image)
+    struct Pair { double score; size_t box; size_t track; };
+    std::vector<Pair> pairs;
+    for (size_t b = 0; b < boxes.size(); b++) {
+        for (size_t t = 0; t < tracks.size(); t++) {
+            double score = iou(boxes[b], tracks[t].box);
+            if (score >= min_iou_) {
+                pairs.push_back({score, b, t});
+            } else if (centroid_close(boxes[b], tracks[t].box)) {
+                pairs.push_back({0.0, b, t});
+            }
+        }
+    }
+    std::stable_sort(pairs.begin(), pairs.end(),
+                     [](const Pair& a, const Pair& b) { return a.score > b.score; });
+
+    std::vector<int> box_track(boxes.size(), -1);
+    std::vector<char> track_used(tracks.size(), 0);
+    for (const Pair& p : pairs) {
+        if (box_track[p.box] != -1 || track_used[p.track]) continue;
+        box_track[p.box] = (int) p.track;
+        track_used[p.track] = 1;
+    }
+
+    std::vector<Match> matches(boxes.size());
+    for (size_t b = 0; b < boxes.size(); b++) {
+        if (box_track[b] == -1) {
+            Track t = {next_id_++, boxes[b], -1, 0.0, false, 0, now};
+            box_track[b] = (int) tracks.size();
+            tracks.push_back(t);
+        }
+
+        Track& t = tracks[box_track[b]];
+        t.box = boxes[b];
+        t.last_seen = now;
+        t.frames_since_verify++;
+
+        Match& m = matches[b];
+        m.track_id = t.id;
+        m.identify = needs_identify(t);
+        m.label = t.label;
+        m.confidence = t.confidence;
+    }
+    return matches;
+}
+
+void FaceTracker::update(const std::string& stream, int track_id, int label, double confidence) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = streams_.find(stream);
+    if (it == streams_.end()) return;
+    for (Track& t : it->second) {
+        if (t.id != track_id) continue;
+        t.label = label;
+        t.confidence = confidence;
+        t.verified = true;
+        t.frames_since_verify = 0;
+        return;
+    }
+}
+
+void FaceTracker::invalidate() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& s : streams_) {
+        for (Track& t : s.second) t.verified = false;
+    }
+}
+
+size_t FaceTracker::track_count() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    size_t n = 0;
+    for (const auto& s : streams_) n += s.second.size();
+    return n;
+}
@@ -0,0 +1,65 @@
+#include "gallery_loader.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <filesystem>
+#include <thread>
+
+namespace fs = std::filesystem;
+
+std::vector<GalleryFile> load_gallery(const std::string& directory_path, LbphMatcher& model,
+                                      size_t threads, const Preprocess& preprocess,
+                                      const LabelFilter& owns) {
+    std::vector<GalleryFile> files;
+    for (const auto& entry : fs::directory_iterator(directory_path)) {
+        if (!entry.is_regular_file()) continue;
+        GalleryFile f;
+        f.path = entry.path().string();
+        try {
+            f.label = std::stoi(entry.path().stem().string());
+            bool mine = !owns || owns(f.label);
+            f.status = mine ? GalleryFile::BAD_IMAGE : GalleryFile::SKIPPED;  // BAD_IMAGE jusqu'au décodage
+        } catch (const std::exception&) {
+            f.status = GalleryFile::BAD_NAME;
+        }
+        files.push_back(f);
+    }
+    std::sort(files.begin(), files.end(),
+              [](const GalleryFile& a, const GalleryFile& b) { return a.path < b.path; });
+
+    std::vector<size_t> todo;
+    for (size_t i = 0; i < files.size(); i++) {
+        if (files[i].status == GalleryFile::BAD_IMAGE) todo.push_back(i);
+    }
+
+    // Ligne k de la galerie <-> todo[k] : aucune synchronisation sur les données
+    model.resize(todo.size());
+    std::vector<char> keep(todo.size(), 0);
+    std::atomic<size_t> next(0);
+
+    auto work = [&]() {
+        // Une image et un histogramme float par thread : les pixels sont
+        // libérés dès l'extraction, la ligne est écrite au format de la galerie.
+        AlignedFloats hist(model.stride(), 0.0f);
+        for (size_t k = next++; k < todo.size(); k = next++) {
+            GalleryFile& f = files[todo[k]];
+            cv::Mat img = cv::imread(f.path, cv::IMREAD_GRAYSCALE);
+            if (img.empty()) continue;
+            if (preprocess) preprocess(img);
+            if (lbp_histogram(img, model.params(), hist.data())) {
+                model.set_row(k, hist.data(), f.label);
+                f.status = GalleryFile::LOADED;
+                keep[k] = 1;
+            }
+        }
+    };
+
+    threads = std::max<size_t>(1, std::min(threads, todo.size()));
+    std::vector<std::thread> pool;
+    for (size_t t = 1; t < threads; t++) pool.emplace_back(work);
+    work();
+    for (auto& t : pool) t.join();
+
+    model.compact(keep);
+    return files;
+}
@@ -0,0 +1,139 @@
+#include "image_input.hpp"
+
+#include <cstdint>
+#include <cstring>
+
+// Nombre maximal d'images par lot
+static const size_t MAX_BATCH_SIZE = 64;
+
+static bool is_form_body(struct mg_http_message* hm) {
+    struct mg_str* ct = mg_http_get_header(hm, "Content-Type");
+    if (ct != NULL) {
+        return mg_match(*ct, mg_str("application/x-www-form-urlencoded#"), NULL);
+    }
+    // Sans Content-Type, on garde l'ancien comportement si le corps ressemble à un formulaire
+    return hm->body.len >= 5 && memcmp(hm->body.buf, "path=", 5) == 0;
+}
+
+// Dimensions des images brutes passées dans l'URL ; false si absentes.
+static bool get_raw_size(struct mg_http_message* hm, int& width, int& height) {
+    char w[16] = "", h[16] = "";
+    mg_http_get_var(&hm->query, "width", w, sizeof(w));
+    mg_http_get_var(&hm->query, "height", h, sizeof(h));
+    if (w[0] == '\0' && h[0] == '\0') return false;
+    width = atoi(w);
+    height = atoi(h);
+    return true;
+}
+
+// Remplit req depuis des octets encodés ou bruts (width > 0).
+static bool image_from_bytes(const char* buf, size_t len, int width, int height,
+                             ImageRequest& req, std::string& error) {
+    if (width != 0 || height != 0) {
+        if (width <= 0 || height <= 0 || (size_t) width * (size_t) height != len) {
+            error = "Taille d'image brute incohérente";
+            return false;
+        }
+        req.kind = ImageRequest::RAW_GRAY;
+        req.width = width;
+        req.height = height;
+    } else {
+        if (len == 0) {
+            error = "Image vide";
+            return false;
+        }
+        req.kind = ImageRequest::ENCODED;
+    }
+    req.bytes.assign(buf, len);
+    return true;
+}
+
+bool parse_image_request(struct mg_http_message* hm, ImageRequest& req, std::string& error) {
+    int width = 0, height = 0;
+    if (get_raw_size(hm, width, height)) {
+        return image_from_bytes(hm->body.buf, hm->body.len, width, height, req, error);
+    }
+
+    if (is_form_body(hm)) {
+        char path[512];
+        if (mg_http_get_var(&hm->body, "path", path, sizeof(path)) <= 0) {
+            error = "Image invalide";
+            return false;
+        }
+        req.kind = ImageRequest::PATH;
+        req.path = path;
+        return true;
+    }
+
+    if (hm->body.len == 0) {
+        error = "Corps de requête vide";
+        return false;
+    }
+    return image_from_bytes(hm->body.buf, hm->body.len, 0, 0, req, error);
+}
+
+bool parse_image_batch(struct mg_http_message* hm, std::vector<ImageRequest>& reqs,
+                       std::string& error) {
+    int width = 0, height = 0;
+    get_raw_size(hm, width, height);
+
+    struct mg_str* ct = mg_http_get_header(hm, "Content-Type");
+    if (ct != NULL && mg_match(*ct, mg_str("multipart/form-data#"), NULL)) {
+        struct mg_http_part part;
+        size_t ofs = 0;
+        while ((ofs = mg_http_next_multipart(hm->body, ofs, &part)) > 0) {
+            if (reqs.size() == MAX_BATCH_SIZE) {
+                error = "Lot trop grand";
+                return false;
+            }
+            reqs.emplace_back();
+            if (!image_from_bytes(part.body.buf, part.body.len, width, height, reqs.back(), error)) {
+                return false;
+            }
+        }
+    } else {
+        const char* p = hm->body.buf;
+        size_t left = hm->body.len;
+        while (left > 0) {
+            uint32_t len;
+            if (left < 4) {
+                error = "Enregistrement tronqué";
+                return false;
+            }
+            const unsigned char* b = (const unsigned char*) p;
+            len = (uint32_t) b[0] | ((uint32_t) b[1] << 8) | ((uint32_t) b[2] << 16) | ((uint32_t) b[3] << 24);
+            p += 4, left -= 4;
+            if (len > left) {
+                error = "Enregistrement tronqué";
+                return false;
+            }
+            if (reqs.size() == MAX_BATCH_SIZE) {
+                error = "Lot trop grand";
+                return false;
+            }
+            reqs.emplace_back();
+            if (!image_from_bytes(p, len, width, height, reqs.back(), error)) return false;
+            p += len, left -= len;
+        }
+    }
+
+    if (reqs.empty()) {
+        error = "Aucune image dans le lot";
+        return false;
+    }
+    return true;
+}
+
+cv::Mat decode_image_request(const ImageRequest& req) {
+    switch (req.kind) {
+        case ImageRequest::PATH:
+            return cv::imread(req.path, cv::IMREAD_GRAYSCALE);
+        case ImageRequest::ENCODED: {
+            cv::Mat buf(1, (int) req.bytes.size(), CV_8UC1, (void*) req.bytes.data());
+            return cv::imdecode(buf, cv::IMREAD_GRAYSCALE);
+        }
+        case ImageRequest::RAW_GRAY:
+            return cv::Mat(req.height, req.width, CV_8UC1, (void*) req.bytes.data());
+    }
+    return cv::Mat();
+}
@@ -0,0 +1,290 @@
+#include "lbp_features.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#if defined(__x86_64__)
+#include <emmintrin.h>
+#define LBP_SSE2 1
+#endif
+
+size_t lbp_bins(const LbpParams& p) {
+    if (p.uniform) return (size_t) p.neighbors * (p.neighbors - 1) + 3;
+    return (size_t) 1 << p.neighbors;
+}
+
+size_t lbp_histogram_size(const LbpParams& p) {
+    return (size_t) p.grid_x * (size_t) p.grid_y * lbp_bins(p);
+}
+
+// Case de chaque code : motifs uniformes numérotés par code croissant,
+// tous les autres dans la dernière case.
+static std::vector<int> uniform_table(int neighbors) {
+    const int num_patterns = 1 << neighbors;
+    const int other = neighbors * (neighbors - 1) + 2;
+    std::vector<int> table(num_patterns);
+    int next = 0;
+    for (int code = 0; code < num_patterns; code++) {
+        int rotated = ((code >> 1) | ((code & 1) << (neighbors - 1)));
+        int transitions = __builtin_popcount((unsigned) (code ^ rotated));
+        table[code] = transitions <= 2 ? next++ : other;
+    }
+    return table;
+}
+
+// Voisin n du cercle : pixels encadrants et poids bilinéaires (calcul d'OpenCV)
+struct LbpNeighbor {
+    int fx, fy, cx, cy;
+    float w1, w2, w3, w4;
+};
+
+static LbpNeighbor lbp_neighbor(int radius, int neighbors, int n) {
+    float x = static_cast<float>(radius * std::cos(2.0 * CV_PI * n / static_cast<float>(neighbors)));
+    float y = static_cast<float>(-radius * std::sin(2.0 * CV_PI * n / static_cast<float>(neighbors)));
+    LbpNeighbor v;
+    v.fx = static_cast<int>(std::floor(x));
+    v.fy = static_cast<int>(std::floor(y));
+    v.cx = static_cast<int>(std::ceil(x));
+    v.cy = static_cast<int>(std::ceil(y));
+    float ty = y - v.fy;
+    float tx = x - v.fx;
+    v.w1 = (1 - tx) * (1 - ty);
+    v.w2 =      tx  * (1 - ty);
+    v.w3 = (1 - tx) *      ty;
+    v.w4 =      tx  *      ty;
+    return v;
+}
+
+// Bit du voisin pour le pixel (i, j) : interpolation et comparaison d'OpenCV
+static inline int lbp_bit(const cv::Mat& src, const LbpNeighbor& v, int i, int j) {
+    const uchar* row_f = src.ptr<uchar>(i + v.fy);
+    const uchar* row_e = src.ptr<uchar>(i + v.cy);
+    float t = static_cast<float>(v.w1 * row_f[j + v.fx] + v.w2 * row_f[j + v.cx] +
+                                 v.w3 * row_e[j + v.fx] + v.w4 * row_e[j + v.cx]);
+    float c = src.ptr<uchar>(i)[j];
+    return (t > c) || (std::abs(t - c) < std::numeric_limits<float>::epsilon());
+}
+
+/**
+ * Extracteur spécialisé rayon 1, 8 voisins (notre configuration).
+ *
+ * Les 4 voisins axiaux tombent sur un pixel entier : OpenCV leur donne un
+ * poids 1 (les autres poids valent 0 ou ~1e-17, absorbés à l'arrondi), et
+ * la comparaison revient à pixel >= centre, faite sur 16 octets à la fois.
+ * Les 4 diagonaux gardent l'interpolation float d'OpenCV, mêmes opérations
+ * dans le même ordre, sur 4 pixels à la fois. Les codes, sur 8 bits, sont
+ * calculés ligne par ligne et versés aussitôt dans les histogrammes : ni
+ * 8 passes sur l'image ni image de codes en int.
+ *
+ * Résultat identique, au bit près, à l'extracteur générique.
+ */
+struct Lbp8Kernel {
+    LbpNeighbor nb[8];
+    bool axis[8];
+    int ax_dx[8], ax_dy[8];  // voisin axial : décalage du pixel de poids 1
+    bool valid = true;
+};
+
+static Lbp8Kernel make_lbp8_kernel() {
+    Lbp8Kernel k;
+    for (int n = 0; n < 8; n++) {
+        const LbpNeighbor& v = k.nb[n] = lbp_neighbor(1, 8, n);
+        const float w[4] = {v.w1, v.w2, v.w3, v.w4};
+        const int dx[4] = {v.fx, v.cx, v.fx, v.cx};
+        const int dy[4] = {v.fy, v.fy, v.cy, v.cy};
+        int ones = 0, other = -1;
+        bool tiny = true;
+        for (int m = 0; m < 4; m++) {
+            if (w[m] == 1.0f) ones++, other = m;
+            else if (w[m] > 1e-6f) tiny = false;
+        }
+        k.axis[n] = ones == 1 && tiny;
+        if (k.axis[n]) {
+            k.ax_dx[n] = dx[other];
+            k.ax_dy[n] = dy[other];
+        }
+        // Les diagonales doivent rester dans le voisinage 3x3
+        if (std::abs(v.fx) > 1 || std::abs(v.cx) > 1 || std::abs(v.fy) > 1 || std::abs(v.cy) > 1) k.valid = false;
+    }
+    int axes = 0;
+    for (int n = 0; n < 8; n++) axes += k.axis[n];
+    if (axes != 4) k.valid = false;
+    return k;
+}
+
+static const Lbp8Kernel& lbp8_kernel() {
+    static const Lbp8Kernel kernel = make_lbp8_kernel();
+    return kernel;
+}
+
+static inline int lbp8_code(const cv::Mat& src, const Lbp8Kernel& k, int i, int j) {
+    int code = 0;
+    for (int n = 0; n < 8; n++) code |= lbp_bit(src, k.nb[n], i, j) << n;
+    return code;
+}
+
+#ifdef LBP_SSE2
+// 16 codes à partir de la colonne j de la ligne i
+static inline __m128i lbp8_codes16(const cv::Mat& src, const Lbp8Kernel& k, int i, int j) {
+    const __m128i c8 = _mm_loadu_si128((const __m128i*) (src.ptr<uchar>(i) + j));
+    const __m128i zero = _mm_setzero_si128();
+    __m128i c16[2] = {_mm_unpacklo_epi8(c8, zero), _mm_unpackhi_epi8(c8, zero)};
+    __m128 cf[4];
+    for (int q = 0; q < 4; q++) {
+        cf[q] = _mm_cvtepi32_ps(q % 2 == 0 ? _mm_unpacklo_epi16(c16[q / 2], zero)
+                                           : _mm_unpackhi_epi16(c16[q / 2], zero));
+    }
+    const __m128 eps = _mm_set1_ps(std::numeric_limits<float>::epsilon());
+    const __m128 abs_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+
+    __m128i code = zero;
+    for (int n = 0; n < 8; n++) {
+        __m128i ge;
+        if (k.axis[n]) {
+            __m128i a = _mm_loadu_si128((const __m128i*) (src.ptr<uchar>(i + k.ax_dy[n]) + j + k.ax_dx[n]));
+            ge = _mm_cmpeq_epi8(_mm_max_epu8(a, c8), a);
+        } else {
+            const LbpNeighbor& v = k.nb[n];
+            const uchar* row_f = src.ptr<uchar>(i + v.fy) + j;
+            const uchar* row_e = src.ptr<uchar>(i + v.cy) + j;
+            __m128i p8[4] = {_mm_loadu_si128((const __m128i*) (row_f + v.fx)),
+                             _mm_loadu_si128((const __m128i*) (row_f + v.cx)),
+                             _mm_loadu_si128((const __m128i*) (row_e + v.fx)),
+                             _mm_loadu_si128((const __m128i*) (row_e + v.cx))};
+            const __m128 w[4] = {_mm_set1_ps(v.w1), _mm_set1_ps(v.w2), _mm_set1_ps(v.w3), _mm_set1_ps(v.w4)};
+            __m128i m[4];
+            for (int q = 0; q < 4; q++) {
+                __m128 t = _mm_setzero_ps();
+                for (int tap = 0; tap < 4; tap++) {
+                    __m128i p16 = q < 2 ? _mm_unpacklo_epi8(p8[tap], zero) : _mm_unpackhi_epi8(p8[tap], zero);
+                    __m128i p32 = q % 2 == 0 ? _mm_unpacklo_epi16(p16, zero) : _mm_unpackhi_epi16(p16, zero);
+                    __m128 prod = _mm_mul_ps(w[tap], _mm_cvtepi32_ps(p32));
+                    t = tap == 0 ? prod : _mm_add_ps(t, prod);
+                }
+                __m128 near = _mm_cmplt_ps(_mm_and_ps(_mm_sub_ps(t, cf[q]), abs_mask), eps);
+                m[q] = _mm_castps_si128(_mm_or_ps(_mm_cmpgt_ps(t, cf[q]), near));
+            }
+            ge = _mm_packs_epi16(_mm_packs_epi32(m[0], m[1]), _mm_packs_epi32(m[2], m[3]));
+        }
+        code = _mm_or_si128(code, _mm_and_si128(ge, _mm_set1_epi8((char) (1 << n))));
+    }
+    return code;
+}
+#endif
+
+static bool lbp_histogram_r1n8(const cv::Mat& src, const LbpParams& p, float* hist) {
+    const Lbp8Kernel& k = lbp8_kernel();
+    const int cols = src.cols - 2;
+    const int cell_w = cols / p.grid_x;
+    const int cell_h = (src.rows - 2) / p.grid_y;
+    const int used_cols = cell_w * p.grid_x;  // colonnes hors grille ignorées
+    const int bins = (int) lbp_bins(p);
+
+    static thread_local std::vector<int> table;
+    if (p.uniform && table.size() != 256) table = uniform_table(8);
+
+    // 4 sous-histogrammes entrelacés : deux codes égaux consécutifs ne
+    // dépendent pas du même compteur.
+    std::vector<uint32_t> counts((size_t) 4 * p.grid_x * bins);
+    std::vector<uint8_t> codes(used_cols + 16);
+    const float scale = (float) (1.0 / ((double) cell_w * cell_h));
+
+    for (int gy = 0; gy < p.grid_y; gy++) {
+        std::fill(counts.begin(), counts.end(), 0);
+        for (int r = gy * cell_h; r < (gy + 1) * cell_h; r++) {
+            const int i = r + 1;
+            int c = 0;
+#ifdef LBP_SSE2
+            for (; c + 16 <= used_cols; c += 16) {
+                _mm_storeu_si128((__m128i*) &codes[c], lbp8_codes16(src, k, i, c + 1));
+            }
+#endif
+            for (; c < used_cols; c++) codes[c] = (uint8_t) lbp8_code(src, k, i, c + 1);
+            if (p.uniform) {
+                for (int x = 0; x < used_cols; x++) codes[x] = (uint8_t) table[codes[x]];
+            }
+
+            for (int gx = 0; gx < p.grid_x; gx++) {
+                uint32_t* h = &counts[(size_t) gx * 4 * bins];
+                const uint8_t* cell = &codes[gx * cell_w];
+                int x = 0;
+                for (; x + 4 <= cell_w; x += 4) {
+                    h[cell[x]]++;
+                    h[bins + cell[x + 1]]++;
+                    h[2 * bins + cell[x + 2]]++;
+                    h[3 * bins + cell[x + 3]]++;
+                }
+                for (; x < cell_w; x++) h[cell[x]]++;
+            }
+        }
+        for (int gx = 0; gx < p.grid_x; gx++) {
+            const uint32_t* h = &counts[(size_t) gx * 4 * bins];
+            float* cell = hist + (size_t) (gy * p.grid_x + gx) * bins;
+            for (int b = 0; b < bins; b++) {
+                int count = (int) (h[b] + h[bins + b] + h[2 * bins + b] + h[3 * bins + b]);
+                cell[b] = (float) count * scale;
+            }
+        }
+    }
+    return true;
+}
+
+bool lbp_histogram_generic(const cv::Mat& src, const LbpParams& p, float* hist) {
+    const int radius = p.radius;
+    const int num_patterns = 1 << p.neighbors;
+    const int bins = (int) lbp_bins(p);
+    const int rows = src.rows - 2 * radius;
+    const int cols = src.cols - 2 * radius;
+
+    std::fill(hist, hist + lbp_histogram_size(p), 0.0f);
+    if (src.type() != CV_8UC1 || rows <= 0 || cols <= 0) return false;
+
+    const int cell_w = cols / p.grid_x;
+    const int cell_h = rows / p.grid_y;
+    if (cell_w == 0 || cell_h == 0) return false;
+
+    // 1. Codes LBP étendus (mêmes poids et mêmes arrondis float qu'OpenCV)
+    std::vector<int> codes((size_t) rows * cols, 0);
+    for (int n = 0; n < p.neighbors; n++) {
+        const LbpNeighbor v = lbp_neighbor(radius, p.neighbors, n);
+        for (int i = radius; i < src.rows - radius; i++) {
+            int* out = &codes[(size_t) (i - radius) * cols];
+            for (int j = radius; j < src.cols - radius; j++) {
+                out[j - radius] += lbp_bit(src, v, i, j) << n;
+            }
+        }
+    }
+
+    if (p.uniform) {
+        static thread_local std::vector<int> table;
+        if (table.size() != (size_t) num_patterns) table = uniform_table(p.neighbors);
+        for (int& code : codes) code = table[code];
+    }
+
+    // 2. Histogramme normalisé par cellule (les bords hors grille sont ignorés)
+    const float scale = (float) (1.0 / ((double) cell_w * cell_h));
+    std::vector<int> counts(bins);
+    for (int gy = 0; gy < p.grid_y; gy++) {
+        for (int gx = 0; gx < p.grid_x; gx++) {
+            std::fill(counts.begin(), counts.end(), 0);
+            for (int i = gy * cell_h; i < (gy + 1) * cell_h; i++) {
+                const int* row = &codes[(size_t) i * cols];
+                for (int j = gx * cell_w; j < (gx + 1) * cell_w; j++) counts[row[j]]++;
+            }
+            float* cell = hist + (size_t) (gy * p.grid_x + gx) * bins;
+            for (int k = 0; k < bins; k++) cell[k] = (float) counts[k] * scale;
+        }
+    }
+    return true;
+}
+
+bool lbp_histogram(const cv::Mat& src, const LbpParams& p, float* hist) {
+    if (p.radius == 1 && p.neighbors == 8 && lbp8_kernel().valid && src.type() == CV_8UC1 &&
+        (src.cols - 2) / p.grid_x > 0 && (src.rows - 2) / p.grid_y > 0) {
+        return lbp_histogram_r1n8(src, p, hist);
+    }
+    return lbp_histogram_generic(src, p, hist);
+}
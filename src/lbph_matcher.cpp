@@ -0,0 +1,582 @@
+#include "lbph_matcher.hpp"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <condition_variable>
+#include <mutex>
+#include "ann_index.hpp"
+#include "chisqr.hpp"
+#include "worker_pool.hpp"
+
+// Lignes complétées à un multiple de 16 floats (64 octets) : chaque ligne
+// commence alignée et les noyaux SIMD n'ont pas de reste à traiter.
+static const size_t ROW_ALIGN_FLOATS = 16;
+
+// Blocs par côté du descripteur grossier : 2x2 blocs de la grille 8x8 lisent
+// 16 fois moins de données que la ligne complète.
+static const int COARSE_GRID = 2;
+
+// Marges de la borne inférieure : les sommes grossières sont arrondies en
+// float (erreur absolue ~1e-7 par cellule de masse 1) et le noyau arrondit
+// ses termes (erreur relative). Une ligne n'est écartée qu'au-delà.
+static const double COARSE_REL_SLACK = 1e-4;
+static const double COARSE_ABS_SLACK_PER_CELL = 1e-6;
+
+// Taille des tuiles de nearest_batch() : de quoi rester dans un cache L2
+static const size_t TILE_BYTES = 256 * 1024;
+
+static size_t align_floats(size_t n) {
+    return (n + ROW_ALIGN_FLOATS - 1) / ROW_ALIGN_FLOATS * ROW_ALIGN_FLOATS;
+}
+
+static size_t coarse_size(const LbpParams& p) {
+    return (size_t) std::min(COARSE_GRID, p.grid_x) * std::min(COARSE_GRID, p.grid_y) * lbp_bins(p);
+}
+
+LbphMatcher::LbphMatcher(const LbpParams& params)
+    : params_(params),
+      dim_(lbp_histogram_size(params)),
+      stride_(align_floats(dim_)),
+      coarse_stride_(align_floats(coarse_size(params))) {}
+
+LbphMatcher::~LbphMatcher() = default;
+LbphMatcher::LbphMatcher(LbphMatcher&&) = default;
+LbphMatcher& LbphMatcher::operator=(LbphMatcher&&) = default;
+
+// Valeur entière maximale de chaque format quantifié
+static const float QMAX_U16 = 65535.0f;
+static const float QMAX_U8 = 255.0f;
+
+const char* hist_storage_name(HistStorage storage) {
+    switch (storage) {
+        case HIST_UINT16: return "u16";
+        case HIST_UINT8: return "u8";
+        default: return "float";
+    }
+}
+
+bool parse_hist_storage(const std::string& name, HistStorage& storage) {
+    if (name == "float") storage = HIST_FLOAT32;
+    else if (name == "u16") storage = HIST_UINT16;
+    else if (name == "u8") storage = HIST_UINT8;
+    else return false;
+    return true;
+}
+
+// Quantifie `hist` (dim valeurs) dans `out` (stride cases, complétées par des zéros).
+template <typename Q>
+static float quantize_row(const float* hist, size_t dim, float qmax, Q* out, size_t stride) {
+    float max = *std::max_element(hist, hist + dim);
+    float scale = max > 0.0f ? max / qmax : 1.0f;
+    for (size_t j = 0; j < dim; j++) {
+        out[j] = (Q) std::min(qmax, std::nearbyint(hist[j] / scale));
+    }
+    std::fill(out + dim, out + stride, (Q) 0);
+    return scale;
+}
+
+// Compactage en place d'un tableau de lignes de `stride` éléments
+template <typename V>
+static void compact_rows(V& rows, const std::vector<char>& keep, size_t stride) {
+    size_t kept = 0;
+    for (size_t i = 0; i < keep.size(); i++) {
+        if (!keep[i]) continue;
+        if (kept != i) std::copy(&rows[i * stride], &rows[i * stride] + stride, &rows[kept * stride]);
+        kept++;
+    }
+    rows.resize(kept * stride);
+}
+
+void LbphMatcher::clear() {
+    data_.clear();
+    data16_.clear();
+    data8_.clear();
+    scales_.clear();
+    coarse_.clear();
+    labels_.clear();
+    index_.reset();
+}
+
+void LbphMatcher::reserve(size_t n) {
+    switch (storage_) {
+        case HIST_FLOAT32: data_.reserve(n * stride_); break;
+        case HIST_UINT16: data16_.reserve(n * stride_); break;
+        case HIST_UINT8: data8_.reserve(n * stride_); break;
+    }
+    if (storage_ != HIST_FLOAT32) scales_.reserve(n);
+    coarse_.reserve(n * coarse_stride_);
+    labels_.reserve(n);
+}
+
+size_t LbphMatcher::memory_bytes() const {
+    return data_.capacity() * sizeof(float) + data16_.capacity() * sizeof(uint16_t) +
+           data8_.capacity() + scales_.capacity() * sizeof(float) + coarse_.capacity() * sizeof(float) +
+           labels_.capacity() * sizeof(int);
+}
+
+void LbphMatcher::copy_histogram(size_t i, float* out) const {
+    size_t row = i * stride_;
+    switch (storage_) {
+        case HIST_FLOAT32:
+            std::copy(&data_[row], &data_[row] + dim_, out);
+            break;
+        case HIST_UINT16:
+            for (size_t j = 0; j < dim_; j++) out[j] = (float) data16_[row + j] * scales_[i];
+            break;
+        case HIST_UINT8:
+            for (size_t j = 0; j < dim_; j++) out[j] = (float) data8_[row + j] * scales_[i];
+            break;
+    }
+}
+
+void LbphMatcher::train(const std::vector<cv::Mat>& images, const std::vector<int>& labels) {
+    clear();
+    reserve(images.size());
+    for (size_t i = 0; i < images.size() && i < labels.size(); i++) {
+        add(images[i], labels[i]);
+    }
+}
+
+bool LbphMatcher::add(const cv::Mat& gray, int label) {
+    AlignedFloats hist;
+    if (!extract(gray, hist)) return false;
+    add_histogram(hist.data(), label);
+    return true;
+}
+
+/**
+ * Descripteur grossier : chaque cellule de la grille est ajoutée, bin par
+ * bin, à son bloc. Requête et galerie passent par cette même fonction, donc
+ * deux histogrammes identiques ont une borne exactement nulle.
+ */
+void LbphMatcher::coarse_of(const float* hist, float* out) const {
+    const int bx = std::min(COARSE_GRID, params_.grid_x);
+    const int by = std::min(COARSE_GRID, params_.grid_y);
+    const size_t bins = lbp_bins(params_);
+    std::vector<double> sums((size_t) bx * by * bins, 0.0);
+    for (int gy = 0; gy < params_.grid_y; gy++) {
+        for (int gx = 0; gx < params_.grid_x; gx++) {
+            const float* cell = hist + (size_t) (gy * params_.grid_x + gx) * bins;
+            double* block = &sums[(size_t) ((gy * by / params_.grid_y) * bx + gx * bx / params_.grid_x) * bins];
+            for (size_t k = 0; k < bins; k++) block[k] += cell[k];
+        }
+    }
+    for (size_t j = 0; j < sums.size(); j++) out[j] = (float) sums[j];
+    std::fill(out + sums.size(), out + coarse_stride_, 0.0f);
+}
+
+// Recalcule le descripteur grossier de la ligne i à partir des valeurs vues
+// par le noyau (déquantifiées si besoin).
+void LbphMatcher::update_coarse(size_t i) {
+    if (storage_ == HIST_FLOAT32) {
+        coarse_of(&data_[i * stride_], &coarse_[i * coarse_stride_]);
+        return;
+    }
+    std::vector<float> row(dim_);
+    copy_histogram(i, row.data());
+    coarse_of(row.data(), &coarse_[i * coarse_stride_]);
+}
+
+// Écrit la ligne i (déjà allouée) au format courant, descripteur grossier compris
+void LbphMatcher::write_row(size_t i, const float* hist) {
+    size_t row = i * stride_;
+    switch (storage_) {
+        case HIST_FLOAT32:
+            std::copy(hist, hist + dim_, &data_[row]);
+            std::fill(&data_[row] + dim_, &data_[row] + stride_, 0.0f);
+            break;
+        case HIST_UINT16:
+            scales_[i] = quantize_row(hist, dim_, QMAX_U16, &data16_[row], stride_);
+            break;
+        case HIST_UINT8:
+            scales_[i] = quantize_row(hist, dim_, QMAX_U8, &data8_[row], stride_);
+            break;
+    }
+    update_coarse(i);
+}
+
+// Alloue n lignes à zéro au format courant (sans toucher aux labels)
+void LbphMatcher::allocate_rows(size_t n) {
+    switch (storage_) {
+        case HIST_FLOAT32: data_.resize(n * stride_, 0.0f); break;
+        case HIST_UINT16: data16_.resize(n * stride_, 0); break;
+        case HIST_UINT8: data8_.resize(n * stride_, 0); break;
+    }
+    if (storage_ != HIST_FLOAT32) scales_.resize(n, 1.0f);
+    coarse_.resize(n * coarse_stride_, 0.0f);
+}
+
+// Ajoute une ligne au format courant (sans label)
+void LbphMatcher::store_row(const float* hist) {
+    allocate_rows(labels_.size() + 1);
+    write_row(labels_.size(), hist);
+}
+
+void LbphMatcher::add_histogram(const float* hist, int label) {
+    store_row(hist);
+    if (index_) index_->add(hist, (uint32_t) labels_.size());
+    labels_.push_back(label);
+}
+
+void LbphMatcher::resize(size_t n) {
+    clear();
+    allocate_rows(n);
+    labels_.assign(n, 0);
+}
+
+void LbphMatcher::set_row(size_t i, const float* hist, int label) {
+    write_row(i, hist);
+    labels_[i] = label;
+}
+
+void LbphMatcher::compact(const std::vector<char>& keep) {
+    // Compactage en place : l'ordre relatif des entrées restantes est conservé
+    switch (storage_) {
+        case HIST_FLOAT32: compact_rows(data_, keep, stride_); break;
+        case HIST_UINT16: compact_rows(data16_, keep, stride_); break;
+        case HIST_UINT8: compact_rows(data8_, keep, stride_); break;
+    }
+    if (storage_ != HIST_FLOAT32) compact_rows(scales_, keep, 1);
+    compact_rows(coarse_, keep, coarse_stride_);
+    compact_rows(labels_, keep, 1);
+    if (index_) index_->remap(keep);
+}
+
+size_t LbphMatcher::remove_label(int label) {
+    std::vector<char> keep(labels_.size());
+    for (size_t i = 0; i < labels_.size(); i++) keep[i] = labels_[i] != label;
+    size_t before = labels_.size();
+    compact(keep);
+    return before - labels_.size();
+}
+
+size_t LbphMatcher::count_label(int label) const {
+    return (size_t) std::count(labels_.begin(), labels_.end(), label);
+}
+
+void LbphMatcher::set_storage(HistStorage storage) {
+    if (storage == storage_) return;
+
+    // Conversion ligne par ligne via le float : l'ancien et le nouveau
+    // format coexistent le temps de la copie.
+    LbphMatcher converted(params_);
+    converted.storage_ = storage;
+    converted.reserve(size());
+    std::vector<float> row(dim_);
+    for (size_t i = 0; i < size(); i++) {
+        copy_histogram(i, row.data());
+        converted.store_row(row.data());
+        converted.labels_.push_back(labels_[i]);
+    }
+
+    storage_ = storage;
+    data_ = std::move(converted.data_);
+    data16_ = std::move(converted.data16_);
+    data8_ = std::move(converted.data8_);
+    scales_ = std::move(converted.scales_);
+    coarse_ = std::move(converted.coarse_);
+    data_.shrink_to_fit();
+}
+
+QuantizationReport LbphMatcher::compare_storage(HistStorage storage, size_t queries,
+                                                size_t max_rows) const {
+    QuantizationReport report;
+    size_t n = std::min(size(), max_rows);
+    if (n < 2) return report;
+
+    LbphMatcher other(params_);
+    other.storage_ = storage;
+    other.reserve(n);
+    AlignedFloats row(stride_, 0.0f);
+    for (size_t i = 0; i < n; i++) {
+        copy_histogram(i, row.data());
+        other.add_histogram(row.data(), labels_[i]);
+    }
+
+    // Chaque requête est une ligne de la galerie, comparée à toutes les autres
+    report.queries = std::min(queries, n);
+    double error = 0.0;
+    for (size_t q = 0; q < report.queries; q++) {
+        size_t self = q * n / report.queries;
+        copy_histogram(self, row.data());
+
+        size_t best_a = self, best_b = self;
+        double da = DBL_MAX, db = DBL_MAX;
+        for (size_t i = 0; i < n; i++) {
+            if (i == self) continue;
+            double a = row_distance(row.data(), i);
+            double b = other.row_distance(row.data(), i);
+            if (a < da) { da = a; best_a = i; }
+            if (b < db) { db = b; best_b = i; }
+        }
+        if (labels_[best_a] == labels_[best_b]) report.agree++;
+        if (da > 0.0) error += std::fabs(db - da) / da;
+    }
+    report.mean_rel_error = error / report.queries;
+    return report;
+}
+
+bool LbphMatcher::extract(const cv::Mat& gray, AlignedFloats& query) const {
+    query.assign(stride_, 0.0f);
+    return lbp_histogram(gray, params_, query.data());
+}
+
+void LbphMatcher::predict(const cv::Mat& gray, int& label, double& distance) const {
+    label = -1;
+    distance = DBL_MAX;
+    AlignedFloats query;
+    if (!extract(gray, query)) return;
+    nearest(query.data(), label, distance);
+}
+
+bool LbphMatcher::build_index(const AnnParams& params, size_t threads) {
+    index_.reset();
+    if (params.min_size == 0 || labels_.size() < params.min_size) return false;
+    index_.reset(new IvfIndex(dim_, params));
+    index_->build(*this, threads);
+    return true;
+}
+
+double LbphMatcher::row_distance(const float* query, size_t i) const {
+    switch (storage_) {
+        case HIST_UINT16: return chisqr_u16_kernel()(query, &data16_[i * stride_], scales_[i], stride_);
+        case HIST_UINT8: return chisqr_u8_kernel()(query, &data8_[i * stride_], scales_[i], stride_);
+        default: return chisqr_kernel()(query, &data_[i * stride_], stride_);
+    }
+}
+
+double LbphMatcher::row_distance_bounded(const float* query, size_t i, double bound) const {
+    const KernelSet& k = chisqr_kernels();
+    switch (storage_) {
+        case HIST_UINT16: return k.u16_bounded(query, &data16_[i * stride_], scales_[i], stride_, bound);
+        case HIST_UINT8: return k.u8_bounded(query, &data8_[i * stride_], scales_[i], stride_, bound);
+        default: return k.f32_bounded(query, &data_[i * stride_], stride_, bound);
+    }
+}
+
+/**
+ * 1. Borne inférieure de chaque ligne par le chi-carré grossier (lecture de
+ *    coarse_ seulement).
+ * 2. Lignes visitées par borne croissante ; arrêt dès que la borne dépasse
+ *    la meilleure distance, les suivantes ne pouvant faire mieux.
+ * 3. Distance complète avec abandon anticipé au-delà de la meilleure.
+ * L'ordre de visite change, pas la règle : à distance égale, la ligne de
+ * plus petit indice l'emporte, comme dans le parcours linéaire.
+ */
+// Borne grossière (descripteur `coarse` de la requête) des lignes [begin, end)
+void LbphMatcher::coarse_bounds(const float* coarse, size_t begin, size_t end, double* bounds) const {
+    chisqr_fn kernel = chisqr_kernel();
+    for (size_t i = begin; i < end; i++) {
+        bounds[i] = kernel(coarse, &coarse_[i * coarse_stride_], coarse_stride_);
+    }
+}
+
+// Vrai si une ligne de borne `bound` ne peut pas battre `best`, marges comprises
+bool LbphMatcher::bound_exceeds(double bound, double best) const {
+    const double abs_slack = COARSE_ABS_SLACK_PER_CELL * params_.grid_x * params_.grid_y;
+    return bound * (1.0 - COARSE_REL_SLACK) - abs_slack > best;
+}
+
+/**
+ * Plus proche voisin parmi les lignes [begin, end) :
+ * 1. lignes visitées par borne grossière croissante ;
+ * 2. arrêt dès que la borne dépasse la meilleure distance, les suivantes
+ *    ne pouvant faire mieux ;
+ * 3. distance complète avec abandon anticipé au-delà de la meilleure.
+ * `shared` (optionnel) est la meilleure distance des autres partitions :
+ * elle resserre la borne mais n'est jamais retenue comme résultat.
+ * À distance égale, la ligne de plus petit indice l'emporte, comme dans le
+ * parcours linéaire. best == end si aucune ligne ne fait mieux.
+ */
+void LbphMatcher::scan_rows(const float* query, const double* bounds, size_t begin, size_t end,
+                            std::atomic<double>* shared, size_t& best, double& distance) const {
+    std::vector<std::pair<double, uint32_t>> order;
+    order.reserve(end - begin);
+    for (size_t i = begin; i < end; i++) order.emplace_back(bounds[i], (uint32_t) i);
+    std::sort(order.begin(), order.end());
+
+    best = end;
+    distance = DBL_MAX;
+    for (const auto& candidate : order) {
+        double limit = shared ? std::min(distance, shared->load(std::memory_order_relaxed)) : distance;
+        if (bound_exceeds(candidate.first, limit)) break;
+        size_t i = candidate.second;
+        double d = row_distance_bounded(query, i, limit);
+        if (d > limit) continue;  // abandonnée : pas une distance exacte
+        if (d < distance || (d == distance && i < best)) {
+            distance = d;
+            best = i;
+            if (shared) {
+                double seen = shared->load(std::memory_order_relaxed);
+                while (d < seen && !shared->compare_exchange_weak(seen, d, std::memory_order_relaxed)) {}
+            }
+        }
+    }
+}
+
+void LbphMatcher::nearest(const float* query, int& label, double& distance) const {
+    if (index_) {
+        nearest_indexed(query, label, distance);
+        return;
+    }
+    if (search_pool_ && parallel_min_rows_ > 0 && labels_.size() >= parallel_min_rows_) {
+        nearest_parallel(query, label, distance);
+        return;
+    }
+
+    const size_t n = labels_.size();
+    label = -1;
+    distance = DBL_MAX;
+    if (n == 0) return;
+
+    AlignedFloats coarse(coarse_stride_);
+    coarse_of(query, coarse.data());
+    std::vector<double> bounds(n);
+    coarse_bounds(coarse.data(), 0, n, bounds.data());
+    size_t best;
+    scan_rows(query, bounds.data(), 0, n, nullptr, best, distance);
+    if (best < n) label = labels_[best];
+}
+
+void LbphMatcher::set_parallel_search(std::shared_ptr<WorkerPool> pool, size_t min_rows) {
+    search_pool_ = std::move(pool);
+    parallel_min_rows_ = min_rows;
+}
+
+/**
+ * Une partition contiguë par thread du pool, plus une pour l'appelant, qui
+ * attend ensuite les autres. Les partitions partagent leur meilleure
+ * distance pour élaguer plus tôt ; la réduction retient la plus petite
+ * distance, puis la plus petite ligne : le résultat du parcours en série.
+ */
+void LbphMatcher::nearest_parallel(const float* query, int& label, double& distance) const {
+    const size_t n = labels_.size();
+    const size_t parts = std::min(n, search_pool_->size() + 1);
+
+    AlignedFloats coarse(coarse_stride_);
+    coarse_of(query, coarse.data());
+    std::vector<double> bounds(n);
+    std::vector<size_t> bests(parts);
+    std::vector<double> distances(parts);
+    std::atomic<double> shared(DBL_MAX);
+
+    auto work = [&](size_t p) {
+        size_t begin = n * p / parts, end = n * (p + 1) / parts;
+        coarse_bounds(coarse.data(), begin, end, bounds.data());
+        scan_rows(query, bounds.data(), begin, end, &shared, bests[p], distances[p]);
+        if (bests[p] == end) bests[p] = n;
+    };
+
+    std::mutex mutex;
+    std::condition_variable done;
+    size_t remaining = parts - 1;
+    for (size_t p = 1; p < parts; p++) {
+        search_pool_->submit([&, p]() {
+            work(p);
+            std::lock_guard<std::mutex> lock(mutex);
+            if (--remaining == 0) done.notify_one();
+        });
+    }
+    work(0);
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [&] { return remaining == 0; });
+    }
+
+    size_t best = n;
+    distance = DBL_MAX;
+    for (size_t p = 0; p < parts; p++) {
+        if (bests[p] < n && (distances[p] < distance || (distances[p] == distance && bests[p] < best))) {
+            distance = distances[p];
+            best = bests[p];
+        }
+    }
+    label = best < n ? labels_[best] : -1;
+}
+
+/**
+ * Lot de requêtes : la galerie est parcourue par tuiles de TILE_BYTES, et
+ * chaque tuile est comparée à toutes les requêtes pendant qu'elle est en
+ * cache. Chaque octet de la galerie vient donc une fois de la mémoire par
+ * lot, au lieu d'une fois par requête.
+ *
+ * Par requête, la ligne de plus petite borne grossière fixe la première
+ * distance ; les tuiles ne calculent ensuite que les lignes dont la borne
+ * reste sous la meilleure distance, avec abandon anticipé. Mêmes résultats
+ * que nearest() requête par requête.
+ */
+void LbphMatcher::nearest_batch(const std::vector<const float*>& queries, std::vector<int>& labels,
+                                std::vector<double>& distances) const {
+    const size_t count = queries.size();
+    const size_t n = labels_.size();
+    labels.assign(count, -1);
+    distances.assign(count, DBL_MAX);
+    if (index_ || count == 1) {
+        // Avec l'index, les candidats diffèrent d'une requête à l'autre
+        for (size_t q = 0; q < count; q++) nearest(queries[q], labels[q], distances[q]);
+        return;
+    }
+    if (n == 0) return;
+
+    AlignedFloats coarse(coarse_stride_);
+    std::vector<double> bounds(count * n);
+    std::vector<size_t> best(count);
+    for (size_t q = 0; q < count; q++) {
+        double* b = &bounds[q * n];
+        coarse_of(queries[q], coarse.data());
+        coarse_bounds(coarse.data(), 0, n, b);
+        best[q] = std::min_element(b, b + n) - b;
+        distances[q] = row_distance(queries[q], best[q]);
+    }
+
+    size_t row_bytes = stride_ * (storage_ == HIST_UINT16 ? sizeof(uint16_t)
+                                  : storage_ == HIST_UINT8 ? sizeof(uint8_t) : sizeof(float));
+    size_t tile = std::max<size_t>(1, TILE_BYTES / row_bytes);
+    for (size_t start = 0; start < n; start += tile) {
+        size_t end = std::min(n, start + tile);
+        for (size_t q = 0; q < count; q++) {
+            const double* b = &bounds[q * n];
+            for (size_t i = start; i < end; i++) {
+                if (bound_exceeds(b[i], distances[q])) continue;
+                double d = row_distance_bounded(queries[q], i, distances[q]);
+                if (d < distances[q] || (d == distances[q] && i < best[q])) {
+                    distances[q] = d;
+                    best[q] = i;
+                }
+            }
+        }
+    }
+    for (size_t q = 0; q < count; q++) labels[q] = labels_[best[q]];
+}
+
+// Seules les lignes du label sont lues (le tableau de labels est parcouru,
+// pas la matrice) ; l'abandon anticipé s'applique entre ses images.
+bool LbphMatcher::nearest_in_label(const float* query, int label, double& distance) const {
+    distance = DBL_MAX;
+    bool found = false;
+    for (size_t i = 0; i < labels_.size(); i++) {
+        if (labels_[i] != label) continue;
+        found = true;
+        double d = row_distance_bounded(query, i, distance);
+        if (d < distance) distance = d;
+    }
+    return found;
+}
+
+// Distance exacte sur les seuls candidats de l'index, parcourus par ligne
+// croissante : même règle d'égalité que le parcours complet.
+void LbphMatcher::nearest_indexed(const float* query, int& label, double& distance) const {
+    std::vector<uint32_t> rows;
+    index_->candidates(query, rows);
+
+    label = -1;
+    distance = DBL_MAX;
+    for (uint32_t i : rows) {
+        double d = row_distance_bounded(query, i, distance);
+        if (d < distance) {
+            distance = d;
+            label = labels_[i];
+        }
+    }
+}
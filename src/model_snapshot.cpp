@@ -0,0 +1,393 @@
+#include "model_snapshot.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+static const char SNAPSHOT_MAGIC[8] = {'L', 'B', 'P', 'H', 'S', 'N', 'A', 'P'};
+// 2 : mode LBP uniforme dans l'en-tête
+// 3 : format de stockage de la galerie (float, u16, u8) dans l'en-tête
+static const uint32_t SNAPSHOT_VERSION = 3;
+
+// Hachage 64 bits mot par mot (FNV-1a élargi) : assez rapide pour ne pas
+// coûter plus que la lecture du fichier, assez bon pour détecter la corruption.
+// Le résultat ne dépend pas du découpage des appels à update().
+class Checksum {
+public:
+    void update(const void* data, size_t len) {
+        const unsigned char* p = static_cast<const unsigned char*>(data);
+        total_ += len;
+        while (len > 0 && npending_ > 0) {
+            push_byte(*p++);
+            len--;
+        }
+        for (; len >= 8; p += 8, len -= 8) {
+            uint64_t w;
+            memcpy(&w, p, 8);
+            mix(w);
+        }
+        while (len-- > 0) push_byte(*p++);
+    }
+
+    uint64_t value() const {
+        Checksum c = *this;
+        c.mix(c.pending_ ^ (c.total_ << 3));
+        return c.h_;
+    }
+
+private:
+    void push_byte(unsigned char b) {
+        pending_ |= (uint64_t) b << (8 * npending_);
+        if (++npending_ == 8) {
+            mix(pending_);
+            pending_ = 0;
+            npending_ = 0;
+        }
+    }
+    void mix(uint64_t w) {
+        h_ ^= w;
+        h_ *= 0x100000001b3ULL;
+        h_ ^= h_ >> 29;
+    }
+
+    uint64_t h_ = 0xcbf29ce484222325ULL;
+    uint64_t pending_ = 0;
+    size_t npending_ = 0;
+    uint64_t total_ = 0;
+};
+
+struct SnapshotHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t radius, neighbors, grid_x, grid_y;
+    uint32_t uniform;
+    uint32_t storage;   // HistStorage de la galerie sauvegardée
+    uint32_t reserved;  // alignement explicite (à zéro)
+    uint64_t fingerprint;
+    uint64_t count;
+    uint64_t dim;
+};
+
+static const char JOURNAL_MAGIC[8] = {'L', 'B', 'P', 'H', 'J', 'R', 'N', 'L'};
+static const uint32_t JOURNAL_VERSION = 1;
+
+// Type d'un enregistrement ; JOURNAL_COMMIT marque le dernier d'un lot
+static const uint32_t JOURNAL_ADD = 1;
+static const uint32_t JOURNAL_REMOVE = 2;
+static const uint32_t JOURNAL_COMMIT = 0x100;
+
+struct JournalHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+    uint64_t dim;
+    uint64_t base;  // empreinte de l'instantané auquel il s'applique
+};
+
+struct JournalRecord {
+    int32_t label;
+    uint32_t kind;
+    uint64_t fingerprint;  // empreinte du dossier après le lot
+};
+
+static SnapshotHeader make_header(const LbphMatcher& model, uint64_t fingerprint) {
+    SnapshotHeader h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, SNAPSHOT_MAGIC, sizeof(h.magic));
+    h.version = SNAPSHOT_VERSION;
+    h.radius = (uint32_t) model.params().radius;
+    h.neighbors = (uint32_t) model.params().neighbors;
+    h.grid_x = (uint32_t) model.params().grid_x;
+    h.grid_y = (uint32_t) model.params().grid_y;
+    h.uniform = model.params().uniform ? 1 : 0;
+    h.storage = (uint32_t) model.storage();
+    h.fingerprint = fingerprint;
+    h.count = model.size();
+    h.dim = model.dim();
+    return h;
+}
+
+uint64_t directory_fingerprint(const std::string& directory_path, const std::string& salt) {
+    struct Entry {
+        std::string name;
+        uint64_t size;
+        int64_t mtime;
+    };
+    std::vector<Entry> entries;
+    std::error_code ec;
+    for (const auto& entry : fs::directory_iterator(directory_path, ec)) {
+        if (!entry.is_regular_file(ec)) continue;
+        Entry e;
+        e.name = entry.path().filename().string();
+        e.size = (uint64_t) entry.file_size(ec);
+        e.mtime = (int64_t) entry.last_write_time(ec).time_since_epoch().count();
+        entries.push_back(e);
+    }
+    std::sort(entries.begin(), entries.end(),
+              [](const Entry& a, const Entry& b) { return a.name < b.name; });
+
+    Checksum sum;
+    sum.update(salt.data(), salt.size());
+    for (const auto& e : entries) {
+        sum.update(e.name.data(), e.name.size() + 1);  // +1 : séparateur \0
+        sum.update(&e.size, sizeof(e.size));
+        sum.update(&e.mtime, sizeof(e.mtime));
+    }
+    return sum.value();
+}
+
+bool save_snapshot(const std::string& path, const LbphMatcher& model, uint64_t fingerprint) {
+    std::string tmp = path + ".tmp";
+    std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+    if (!out) return false;
+
+    Checksum sum;
+    auto write = [&](const void* p, size_t len) {
+        out.write(static_cast<const char*>(p), (std::streamsize) len);
+        sum.update(p, len);
+    };
+
+    SnapshotHeader h = make_header(model, fingerprint);
+    write(&h, sizeof(h));
+    std::vector<int32_t> labels(model.size());
+    for (size_t i = 0; i < model.size(); i++) labels[i] = model.label(i);
+    write(labels.data(), labels.size() * sizeof(int32_t));
+    // Toujours en float sur disque, quel que soit le stockage en mémoire
+    std::vector<float> row(model.dim());
+    for (size_t i = 0; i < model.size(); i++) {
+        model.copy_histogram(i, row.data());
+        write(row.data(), row.size() * sizeof(float));
+    }
+    uint64_t checksum = sum.value();
+    out.write(reinterpret_cast<const char*>(&checksum), sizeof(checksum));
+    out.close();
+
+    // Le journal de l'ancien instantané disparaît avant le remplacement :
+    // un arrêt entre les deux laisse l'ancien instantané seul, refusé au
+    // démarrage (son empreinte n'est plus celle du dossier).
+    std::error_code ec;
+    if (out) fs::remove(journal_path(path), ec);
+    if (!out || ec) {
+        std::remove(tmp.c_str());
+        return false;
+    }
+    return std::rename(tmp.c_str(), path.c_str()) == 0;
+}
+
+std::string journal_path(const std::string& snapshot_path) {
+    return snapshot_path + ".journal";
+}
+
+static bool same_journal(const JournalHeader& h, size_t dim, uint64_t base) {
+    return memcmp(h.magic, JOURNAL_MAGIC, sizeof(h.magic)) == 0 && h.version == JOURNAL_VERSION &&
+           h.dim == dim && h.base == base;
+}
+
+bool append_journal(const std::string& snapshot_path, size_t dim, uint64_t base,
+                    const std::vector<JournalEdit>& edits, uint64_t fingerprint) {
+    if (edits.empty()) return true;
+    for (const JournalEdit& edit : edits) {
+        if (!edit.hist.empty() && edit.hist.size() != dim) return false;
+    }
+
+    std::string path = journal_path(snapshot_path);
+    std::error_code ec;
+    bool fresh = !fs::exists(path, ec) || fs::file_size(path, ec) == 0;
+    if (!fresh) {
+        // Journal d'un autre instantané : l'appelant doit compacter
+        JournalHeader h;
+        std::ifstream in(path, std::ios::binary);
+        if (!in.read(reinterpret_cast<char*>(&h), sizeof(h)) || !same_journal(h, dim, base)) return false;
+    }
+
+    std::ofstream out(path, std::ios::binary | std::ios::app);
+    if (!out) return false;
+    if (fresh) {
+        JournalHeader h;
+        memset(&h, 0, sizeof(h));
+        memcpy(h.magic, JOURNAL_MAGIC, sizeof(h.magic));
+        h.version = JOURNAL_VERSION;
+        h.dim = dim;
+        h.base = base;
+        out.write(reinterpret_cast<const char*>(&h), sizeof(h));
+    }
+    for (size_t e = 0; e < edits.size(); e++) {
+        const JournalEdit& edit = edits[e];
+        JournalRecord r;
+        memset(&r, 0, sizeof(r));
+        r.label = edit.label;
+        r.kind = (edit.hist.empty() ? JOURNAL_REMOVE : JOURNAL_ADD) | (e + 1 == edits.size() ? JOURNAL_COMMIT : 0);
+        r.fingerprint = fingerprint;
+
+        Checksum sum;
+        sum.update(&r, sizeof(r));
+        sum.update(edit.hist.data(), edit.hist.size() * sizeof(float));
+        uint64_t checksum = sum.value();
+        out.write(reinterpret_cast<const char*>(&r), sizeof(r));
+        out.write(reinterpret_cast<const char*>(edit.hist.data()), (std::streamsize) (edit.hist.size() * sizeof(float)));
+        out.write(reinterpret_cast<const char*>(&checksum), sizeof(checksum));
+    }
+    out.close();
+    return (bool) out;
+}
+
+/**
+ * Parcourt le journal rattaché à l'instantané `base` et retourne le nombre
+ * d'enregistrements jusqu'au dernier lot complet ; `fingerprint` reçoit
+ * l'empreinte du dossier après ce lot (inchangée si aucun). Le parcours
+ * s'arrête au premier enregistrement incomplet ou corrompu.
+ * `model` non nul : y rejoue les `limit` premiers enregistrements.
+ */
+static size_t read_journal(const std::string& snapshot_path, size_t dim, uint64_t base, uint64_t& fingerprint,
+                           LbphMatcher* model, size_t limit) {
+    std::ifstream in(journal_path(snapshot_path), std::ios::binary);
+    JournalHeader h;
+    if (!in || !in.read(reinterpret_cast<char*>(&h), sizeof(h)) || !same_journal(h, dim, base)) return 0;
+
+    size_t committed = 0;
+    std::vector<float> hist(dim);
+    for (size_t i = 0;; i++) {
+        JournalRecord r;
+        if (!in.read(reinterpret_cast<char*>(&r), sizeof(r))) break;
+        uint32_t op = r.kind & ~JOURNAL_COMMIT;
+        if (op != JOURNAL_ADD && op != JOURNAL_REMOVE) break;
+        size_t floats = op == JOURNAL_ADD ? dim : 0;
+        uint64_t checksum = 0;
+        if (!in.read(reinterpret_cast<char*>(hist.data()), (std::streamsize) (floats * sizeof(float))) ||
+            !in.read(reinterpret_cast<char*>(&checksum), sizeof(checksum))) {
+            break;
+        }
+        Checksum sum;
+        sum.update(&r, sizeof(r));
+        sum.update(hist.data(), floats * sizeof(float));
+        if (checksum != sum.value()) break;
+
+        if (model != nullptr && i < limit) {
+            if (op == JOURNAL_ADD) {
+                model->add_histogram(hist.data(), r.label);
+            } else {
+                model->remove_label(r.label);
+            }
+        }
+        if (r.kind & JOURNAL_COMMIT) {
+            committed = i + 1;
+            fingerprint = r.fingerprint;
+        }
+    }
+    return committed;
+}
+
+static bool read_snapshot(const std::string& path, LbphMatcher& model, uint64_t fingerprint,
+                          std::string& reason, size_t& journal_edits) {
+
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        reason = "absent";
+        return false;
+    }
+
+    Checksum sum;
+    auto read = [&](void* p, size_t len) {
+        if (!in.read(static_cast<char*>(p), (std::streamsize) len)) return false;
+        sum.update(p, len);
+        return true;
+    };
+
+    SnapshotHeader h;
+    SnapshotHeader expected = make_header(model, fingerprint);
+    if (!read(&h, sizeof(h)) || memcmp(h.magic, SNAPSHOT_MAGIC, sizeof(h.magic)) != 0) {
+        reason = "format inconnu";
+        return false;
+    }
+    if (h.version != expected.version) {
+        reason = "version " + std::to_string(h.version);
+        return false;
+    }
+    if (h.radius != expected.radius || h.neighbors != expected.neighbors ||
+        h.grid_x != expected.grid_x || h.grid_y != expected.grid_y || h.uniform != expected.uniform ||
+        h.dim != expected.dim) {
+        reason = "paramètres LBP différents";
+        return false;
+    }
+    // Une galerie quantifiée sauvegardée n'a plus la précision float :
+    // on ne la sert pas sous un autre format, on réentraîne.
+    if (h.storage != expected.storage) {
+        reason = "stockage " + std::string(h.storage <= HIST_UINT8 ? hist_storage_name((HistStorage) h.storage) : "?") +
+                 " au lieu de " + hist_storage_name(model.storage());
+        return false;
+    }
+    // Avec un journal, c'est le dossier après son dernier lot complet qui
+    // doit être celui d'aujourd'hui
+    uint64_t expected_fingerprint = h.fingerprint;
+    size_t edits = read_journal(path, h.dim, h.fingerprint, expected_fingerprint, nullptr, 0);
+    if (expected_fingerprint != fingerprint) {
+        reason = "dossier d'images modifié";
+        return false;
+    }
+
+    // Le nombre vient du fichier : il doit correspondre exactement à sa
+    // taille avant toute allocation (dim est déjà celle du modèle).
+    std::error_code ec;
+    uint64_t file_size = (uint64_t) fs::file_size(path, ec);
+    uint64_t row_bytes = sizeof(int32_t) + h.dim * sizeof(float);
+    if (ec || file_size < sizeof(h) + sizeof(uint64_t)) {
+        reason = "tronqué";
+        return false;
+    }
+    uint64_t payload = file_size - sizeof(h) - sizeof(uint64_t);
+    if (payload % row_bytes != 0 || h.count != payload / row_bytes) {
+        reason = "taille incohérente avec l'en-tête";
+        return false;
+    }
+
+    std::vector<int32_t> labels(h.count);
+    if (!read(labels.data(), labels.size() * sizeof(int32_t))) {
+        reason = "tronqué";
+        return false;
+    }
+
+    // Lecture ligne par ligne : une seule ligne tampon en plus de la galerie.
+    std::vector<float> row(h.dim);
+    model.reserve(h.count);
+    for (uint64_t i = 0; i < h.count; i++) {
+        if (!read(row.data(), row.size() * sizeof(float))) {
+            model.clear();
+            reason = "tronqué";
+            return false;
+        }
+        model.add_histogram(row.data(), labels[i]);
+    }
+
+    uint64_t checksum = 0;
+    if (!in.read(reinterpret_cast<char*>(&checksum), sizeof(checksum)) || checksum != sum.value()) {
+        model.clear();
+        reason = "somme de contrôle invalide";
+        return false;
+    }
+    read_journal(path, h.dim, h.fingerprint, expected_fingerprint, &model, edits);
+    journal_edits = edits;
+    return true;
+}
+
+bool load_snapshot(const std::string& path, LbphMatcher& model, uint64_t fingerprint,
+                   std::string& reason, size_t* journal_edits) {
+    model.clear();
+    // Appelé hors de tout try (thread de chargement) : rien ne doit s'échapper
+    try {
+        size_t edits = 0;
+        if (read_snapshot(path, model, fingerprint, reason, edits)) {
+            if (journal_edits != nullptr) *journal_edits = edits;
+            return true;
+        }
+    } catch (const std::exception& e) {
+        reason = std::string("erreur de lecture : ") + e.what();
+    }
+    model.clear();
+    return false;
+}
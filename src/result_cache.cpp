@@ -0,0 +1,81 @@
+#include "result_cache.hpp"
+
+PHash perceptual_hash(const cv::Mat& gray) {
+    cv::Mat small;
+    cv::resize(gray, small, cv::Size(17, 16), 0, 0, cv::INTER_AREA);
+
+    PHash h = {{0, 0, 0, 0}};
+    int bit = 0;
+    for (int y = 0; y < 16; y++) {
+        const uchar* row = small.ptr<uchar>(y);
+        for (int x = 0; x < 16; x++, bit++) {
+            if (row[x] > row[x + 1]) h.bits[bit >> 6] |= (uint64_t) 1 << (bit & 63);
+        }
+    }
+    return h;
+}
+
+int hamming_distance(const PHash& a, const PHash& b) {
+    int d = 0;
+    for (int i = 0; i < 4; i++) d += __builtin_popcountll(a.bits[i] ^ b.bits[i]);
+    return d;
+}
+
+ResultCache::ResultCache(int capacity, int ttl_ms, int max_hamming)
+    : capacity_(capacity > 0 ? capacity : 0), ttl_(ttl_ms), max_hamming_(max_hamming) {
+    entries_.reserve(capacity_);
+}
+
+bool ResultCache::lookup(const PHash& key, int& label, double& distance) {
+    if (capacity_ == 0) return false;
+
+    Clock::time_point now = Clock::now();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        // Balayage linéaire : quelques centaines d'entrées, 4 popcount chacune
+        const Entry* best = NULL;
+        int best_d = max_hamming_ + 1;
+        for (const Entry& e : entries_) {
+            if (e.expires < now) continue;
+            int d = hamming_distance(e.key, key);
+            if (d < best_d) {
+                best_d = d;
+                best = &e;
+            }
+        }
+        if (best != NULL) {
+            label = best->label;
+            distance = best->distance;
+            hits_.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+    misses_.fetch_add(1, std::memory_order_relaxed);
+    return false;
+}
+
+void ResultCache::insert(const PHash& key, int label, double distance, uint64_t generation) {
+    if (capacity_ == 0) return;
+
+    Entry e = {key, label, distance, Clock::now() + ttl_};
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (generation != generation_.load()) return;  // galerie modifiée entre-temps
+    if (entries_.size() < capacity_) {
+        entries_.push_back(e);
+    } else {
+        entries_[next_] = e;
+        next_ = (next_ + 1) % capacity_;
+    }
+}
+
+void ResultCache::clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    generation_++;
+    entries_.clear();
+    next_ = 0;
+}
+
+size_t ResultCache::size() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return entries_.size();
+}
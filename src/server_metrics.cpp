@@ -0,0 +1,122 @@
+#include "server_metrics.hpp"
+
+#include <cstdint>
+#include <cstdio>
+
+const double LatencyHistogram::BOUNDS[LatencyHistogram::BUCKETS] = {
+    0.0001, 0.00025, 0.0005, 0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1.0, 2.5};
+
+static const char* OUTCOME_NAMES[OUTCOME_COUNT] = {"match", "unknown", "error"};
+
+const char* stage_name(Stage stage) {
+    switch (stage) {
+        case STAGE_DECODE: return "decode";
+        case STAGE_PREPROCESS: return "preprocess";
+        case STAGE_PREDICT: return "predict";
+        case STAGE_REPLY: return "reply";
+        default: return "?";
+    }
+}
+
+std::string server_timing_header(const StageTimes& times) {
+    std::string header = "Server-Timing: ";
+    char item[48];
+    double total = 0.0;
+    for (int s = 0; s < STAGE_COUNT; s++) {
+        if (!times.measured[s]) continue;
+        snprintf(item, sizeof(item), "%s;dur=%.3f, ", stage_name((Stage) s), times.seconds[s] * 1e3);
+        header += item;
+        total += times.seconds[s];
+    }
+    snprintf(item, sizeof(item), "total;dur=%.3f\r\n", total * 1e3);
+    return header + item;
+}
+
+void LatencyHistogram::observe(double seconds) {
+    size_t b = 0;
+    while (b < BUCKETS && seconds > BOUNDS[b]) b++;
+    counts_[b].fetch_add(1, std::memory_order_relaxed);
+    sum_ns_.fetch_add((uint64_t) (seconds * 1e9), std::memory_order_relaxed);
+}
+
+// Une ligne "name{labels} value\n" (sans accolades si labels est vide)
+static void append_sample(std::string& out, const std::string& name, const std::string& labels,
+                          const std::string& value) {
+    out += name;
+    if (!labels.empty()) out += "{" + labels + "}";
+    out += " " + value + "\n";
+}
+
+static void append_header(std::string& out, const std::string& name, const char* type, const char* help) {
+    out += "# HELP " + name + " " + help + "\n";
+    out += "# TYPE " + name + " " + type + "\n";
+}
+
+static std::string format_double(const char* fmt, double v) {
+    char buf[64];
+    snprintf(buf, sizeof(buf), fmt, v);
+    return buf;
+}
+
+void LatencyHistogram::render(std::string& out, const std::string& name, const std::string& labels) const {
+    uint64_t cumulative = 0;
+    for (size_t b = 0; b <= BUCKETS; b++) {
+        cumulative += counts_[b].load(std::memory_order_relaxed);
+        std::string le = b < BUCKETS ? format_double("%g", BOUNDS[b]) : "+Inf";
+        append_sample(out, name + "_bucket", labels + ",le=\"" + le + "\"", std::to_string(cumulative));
+    }
+    append_sample(out, name + "_sum", labels, format_double("%.9f", sum_ns_.load(std::memory_order_relaxed) / 1e9));
+    append_sample(out, name + "_count", labels, std::to_string(cumulative));
+}
+
+ServerMetrics::ServerMetrics(const std::string& prefix) : prefix_(prefix) {}
+
+size_t ServerMetrics::add_endpoint(const std::string& path) {
+    if (endpoint_count_ == MAX_ENDPOINTS) return MAX_ENDPOINTS - 1;
+    endpoints_[endpoint_count_] = path;
+    return endpoint_count_++;
+}
+
+void ServerMetrics::count(size_t endpoint, Outcome outcome) {
+    requests_[endpoint][outcome].fetch_add(1, std::memory_order_relaxed);
+}
+
+void ServerMetrics::observe(Stage stage, double seconds) {
+    stages_[stage].observe(seconds);
+}
+
+void ServerMetrics::observe(const StageTimes& times) {
+    for (int s = 0; s < STAGE_COUNT; s++) {
+        if (times.measured[s]) stages_[s].observe(times.seconds[s]);
+    }
+}
+
+std::string ServerMetrics::render(size_t queue_depth, uint64_t cache_hits, uint64_t cache_misses) const {
+    const std::string& p = prefix_;
+    std::string out;
+
+    append_header(out, p + "_requests_total", "counter",
+                  "Identifications par route et issue (une par visage dans un lot).");
+    for (size_t e = 0; e < endpoint_count_; e++) {
+        for (int o = 0; o < OUTCOME_COUNT; o++) {
+            append_sample(out, p + "_requests_total",
+                          "endpoint=\"" + endpoints_[e] + "\",result=\"" + OUTCOME_NAMES[o] + "\"",
+                          std::to_string(requests_[e][o].load(std::memory_order_relaxed)));
+        }
+    }
+
+    append_header(out, p + "_stage_seconds", "histogram", "Durée des étapes de traitement.");
+    for (int s = 0; s < STAGE_COUNT; s++) {
+        stages_[s].render(out, p + "_stage_seconds", std::string("stage=\"") + stage_name((Stage) s) + "\"");
+    }
+
+    append_header(out, p + "_gallery_size", "gauge", "Images dans la galerie.");
+    append_sample(out, p + "_gallery_size", "", std::to_string(gallery_size_.load(std::memory_order_relaxed)));
+    append_header(out, p + "_queue_depth", "gauge", "Travaux en attente d'un worker.");
+    append_sample(out, p + "_queue_depth", "", std::to_string(queue_depth));
+    append_header(out, p + "_cache_hits_total", "counter", "Réponses servies par le cache.");
+    append_sample(out, p + "_cache_hits_total", "", std::to_string(cache_hits));
+    append_header(out, p + "_cache_misses_total", "counter", "Recherches hors cache.");
+    append_sample(out, p + "_cache_misses_total", "", std::to_string(cache_misses));
+    return out;
+}
@@ -0,0 +1,86 @@
+// async_reply : réponse plus grande qu'un datagramme, réveil perdu
+#include "async_reply.hpp"
+#include "test_check.hpp"
+
+#include <string>
+#include <thread>
+
+static std::string big_body(200000, 'x');
+static int server_status = 0;
+
+struct Client {
+    bool done = false;
+    int status = 0;
+    size_t body_len = 0;
+};
+
+static void server_handler(struct mg_connection* c, int ev, void* ev_data) {
+    if (ev == MG_EV_HTTP_MSG) {
+        // Réponse produite par un autre thread, comme un worker
+        struct mg_mgr* mgr = c->mgr;
+        unsigned long id = c->id;
+        std::thread([mgr, id] {
+            async_reply(mgr, id, server_status, "Content-Type: text/plain\r\n", "%s", big_body.c_str());
+        }).join();
+    } else if (ev == MG_EV_WAKEUP) {
+        send_async_reply(c, (struct mg_str*) ev_data);
+    }
+}
+
+static void client_handler(struct mg_connection* c, int ev, void* ev_data) {
+    Client* client = (Client*) c->fn_data;
+    if (ev == MG_EV_CONNECT) {
+        mg_printf(c, "GET / HTTP/1.1\r\nHost: localhost\r\n\r\n");
+    } else if (ev == MG_EV_HTTP_MSG) {
+        struct mg_http_message* hm = (struct mg_http_message*) ev_data;
+        client->status = mg_http_status(hm);
+        client->body_len = hm->body.len;
+        client->done = true;
+        c->is_closing = 1;
+    } else if (ev == MG_EV_ERROR || ev == MG_EV_CLOSE) {
+        client->done = true;
+    }
+}
+
+// Une requête ; flush : flush_async_replies() après chaque tour de boucle
+static Client request(struct mg_mgr* mgr, const char* url, bool flush) {
+    Client client;
+    mg_http_connect(mgr, url, client_handler, &client);
+    for (int i = 0; i < 200 && !client.done; i++) {
+        mg_mgr_poll(mgr, 10);
+        if (flush) flush_async_replies(mgr);
+    }
+    return client;
+}
+
+int main() {
+    mg_log_set(MG_LL_NONE);
+    struct mg_mgr mgr;
+    mg_mgr_init(&mgr);
+    // Port 0 : choisi par le système
+    struct mg_connection* listener = mg_http_listen(&mgr, "http://127.0.0.1:0", server_handler, NULL);
+    CHECK(listener != NULL);
+    if (listener == NULL) return TEST_RESULT();
+    std::string address = "http://127.0.0.1:" + std::to_string(mg_ntohs(listener->loc.port));
+    const char* url = address.c_str();
+
+    // Sans mg_wakeup_init(), le réveil échoue : la boucle envoie la réponse
+    server_status = 201;
+    Client lost = request(&mgr, url, true);
+    CHECK(lost.status == 201);
+    CHECK(lost.body_len == big_body.size());
+
+    // Réveil normal : seul le numéro de tâche passe par le datagramme
+    CHECK(mg_wakeup_init(&mgr));
+    server_status = 200;
+    Client woken = request(&mgr, url, false);
+    CHECK(woken.status == 200);
+    CHECK(woken.body_len == big_body.size());
+
+    // Client parti avant la réponse : oubliée, rien n'est envoyé
+    async_reply(&mgr, 123456, 200, "", "{}");
+    flush_async_replies(&mgr);
+
+    mg_mgr_free(&mgr);
+    return TEST_RESULT();
+}
@@ -0,0 +1,40 @@
+#ifndef TEST_CHECK_HPP
+#define TEST_CHECK_HPP
+
+#include <opencv2/opencv.hpp>
+#include <algorithm>
+#include <cstdio>
+#include <random>
+
+/**
+ * Assertions des tests (make test) : un échec est affiché avec sa ligne,
+ * le test continue ; main() retourne TEST_RESULT(), non nul en cas d'échec.
+ */
+static int test_failures = 0;
+
+#define CHECK(cond)                                                              \
+    do {                                                                         \
+        if (!(cond)) {                                                           \
+            fprintf(stderr, "%s:%d: échec : %s\n", __FILE__, __LINE__, #cond);   \
+            test_failures++;                                                     \
+        }                                                                        \
+    } while (0)
+
+#define TEST_RESULT() (test_failures == 0 ? (printf("[OK] %s\n", __FILE__), 0) : 1)
+
+// Image grise de synthèse : motif propre à `id`, plus un bruit ±`amp`
+// tiré de `noise` (deux bruits différents : deux photos d'un même visage).
+inline cv::Mat synthetic_gray(int id, unsigned noise, int amp, int rows = 100, int cols = 100) {
+    cv::Mat m(rows, cols, CV_8UC1);
+    std::mt19937 base((unsigned) id * 7919u + 1u), jitter(noise);
+    for (int i = 0; i < rows; i++) {
+        uchar* row = m.ptr<uchar>(i);
+        for (int j = 0; j < cols; j++) {
+            int v = 40 + (int) (base() % 160) + (amp > 0 ? (int) (jitter() % (2 * amp + 1)) - amp : 0);
+            row[j] = (uchar) std::max(0, std::min(255, v));
+        }
+    }
+    return m;
+}
+
+#endif
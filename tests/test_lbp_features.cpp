@@ -0,0 +1,50 @@
+#include "lbp_features.hpp"
+
+#include <vector>
+#include "test_check.hpp"
+
+// L'extracteur spécialisé (rayon 1, 8 voisins) doit rendre exactement
+// l'histogramme du chemin générique, quelle que soit la taille de l'image.
+static void check_same(const cv::Mat& gray, const LbpParams& p) {
+    std::vector<float> fast(lbp_histogram_size(p), -1.0f), generic(lbp_histogram_size(p), -1.0f);
+    bool ok_fast = lbp_histogram(gray, p, fast.data());
+    bool ok_generic = lbp_histogram_generic(gray, p, generic.data());
+    CHECK(ok_fast == ok_generic);
+    CHECK(fast == generic);
+}
+
+int main() {
+    const int sizes[][2] = {{100, 100}, {200, 200}, {37, 53}, {18, 18}, {10, 250}, {9, 9}, {3, 3}};
+    for (bool uniform : {false, true}) {
+        for (int grid : {8, 3, 1}) {
+            LbpParams p;
+            p.uniform = uniform;
+            p.grid_x = grid;
+            p.grid_y = grid;
+            for (const auto& s : sizes) {
+                check_same(synthetic_gray(s[0] * 31 + s[1], 7, 20, s[0], s[1]), p);
+            }
+        }
+    }
+
+    // Sous-image non contiguë (recadrage d'une image caméra)
+    cv::Mat frame = synthetic_gray(5, 11, 30, 240, 320);
+    check_same(frame(cv::Rect(17, 23, 131, 119)), LbpParams());
+
+    // Trop petite pour la grille : refusée, histogramme à zéro
+    LbpParams p;
+    std::vector<float> hist(lbp_histogram_size(p), 1.0f);
+    CHECK(!lbp_histogram(synthetic_gray(1, 1, 0, 9, 9), p, hist.data()));
+    CHECK(std::count(hist.begin(), hist.end(), 0.0f) == (long) hist.size());
+
+    // Chaque cellule est normalisée : ses cases somment à 1
+    std::vector<float> h(lbp_histogram_size(p));
+    CHECK(lbp_histogram(synthetic_gray(2, 2, 10), p, h.data()));
+    const size_t bins = lbp_bins(p);
+    for (size_t c = 0; c < h.size() / bins; c++) {
+        double sum = 0.0;
+        for (size_t b = 0; b < bins; b++) sum += h[c * bins + b];
+        CHECK(sum > 0.999 && sum < 1.001);
+    }
+    return TEST_RESULT();
+}
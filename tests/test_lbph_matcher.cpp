@@ -0,0 +1,140 @@
+#include "lbph_matcher.hpp"
+
+#include <cfloat>
+#include <memory>
+#include <vector>
+#include "chisqr.hpp"
+#include "test_check.hpp"
+#include "worker_pool.hpp"
+
+static const int IDENTITIES = 40;
+static const int SHOTS = 4;
+
+// Galerie de synthèse : SHOTS photos bruitées par identité
+static void fill_gallery(LbphMatcher& m) {
+    AlignedFloats h;
+    for (int id = 0; id < IDENTITIES; id++) {
+        for (int s = 0; s < SHOTS; s++) {
+            CHECK(m.extract(synthetic_gray(id, 1000u + id * SHOTS + s, 12), h));
+            m.add_histogram(h.data(), id);
+        }
+    }
+}
+
+// Requêtes : nouvelles photos, une ligne de la galerie telle quelle, un histogramme nul
+static std::vector<AlignedFloats> make_queries(const LbphMatcher& m) {
+    std::vector<AlignedFloats> queries;
+    AlignedFloats h;
+    for (int id = 0; id < IDENTITIES; id += 3) {
+        CHECK(m.extract(synthetic_gray(id, 5000u + id, 12), h));
+        queries.push_back(h);
+    }
+    h.assign(m.stride(), 0.0f);
+    m.copy_histogram(7, h.data());
+    queries.push_back(h);
+    queries.push_back(AlignedFloats(m.stride(), 0.0f));
+    return queries;
+}
+
+// Parcours complet, ligne déquantifiée en float, première distance minimale
+static void brute_force(const LbphMatcher& m, const float* query, int& label, double& distance) {
+    AlignedFloats row(m.stride(), 0.0f);
+    label = -1;
+    distance = DBL_MAX;
+    for (size_t i = 0; i < m.size(); i++) {
+        m.copy_histogram(i, row.data());
+        double d = chisqr_kernel()(query, row.data(), m.stride());
+        if (d < distance) {
+            distance = d;
+            label = m.label(i);
+        }
+    }
+}
+
+// nearest, nearest_batch et la recherche parallèle rendent le parcours complet
+static void check_searches(LbphMatcher& m, const std::vector<AlignedFloats>& queries) {
+    std::vector<const float*> ptrs;
+    for (const AlignedFloats& q : queries) ptrs.push_back(q.data());
+    std::vector<int> batch_labels;
+    std::vector<double> batch_distances;
+    m.nearest_batch(ptrs, batch_labels, batch_distances);
+
+    std::shared_ptr<WorkerPool> pool = std::make_shared<WorkerPool>(3);
+    for (size_t q = 0; q < queries.size(); q++) {
+        int ref_label, label, par_label;
+        double ref_distance, distance, par_distance;
+        brute_force(m, ptrs[q], ref_label, ref_distance);
+
+        m.set_parallel_search(nullptr, 0);
+        m.nearest(ptrs[q], label, distance);
+        CHECK(label == ref_label && distance == ref_distance);
+        CHECK(batch_labels[q] == ref_label && batch_distances[q] == ref_distance);
+
+        m.set_parallel_search(pool, 1);
+        m.nearest(ptrs[q], par_label, par_distance);
+        CHECK(par_label == ref_label && par_distance == ref_distance);
+        m.set_parallel_search(nullptr, 0);
+
+        double in_label;
+        CHECK(m.nearest_in_label(ptrs[q], ref_label, in_label));
+        CHECK(in_label == ref_distance);
+    }
+}
+
+int main() {
+    LbphMatcher float_model;
+    fill_gallery(float_model);
+    CHECK(float_model.size() == (size_t) IDENTITIES * SHOTS);
+    std::vector<AlignedFloats> queries = make_queries(float_model);
+    check_searches(float_model, queries);
+
+    // Les nouvelles photos retrouvent leur identité
+    int label;
+    double distance;
+    for (size_t q = 0; q + 2 < queries.size(); q++) {
+        float_model.nearest(queries[q].data(), label, distance);
+        CHECK(label == (int) q * 3);
+    }
+    // Une ligne de la galerie est à distance nulle d'elle-même
+    float_model.nearest(queries[queries.size() - 2].data(), label, distance);
+    CHECK(label == 7 / SHOTS && distance == 0.0);
+
+    // Egalité : la première ligne de distance minimale l'emporte
+    LbphMatcher ties;
+    ties.add_histogram(queries[0].data(), 11);
+    ties.add_histogram(queries[0].data(), 22);
+    ties.nearest(queries[0].data(), label, distance);
+    CHECK(label == 11 && distance == 0.0);
+
+    // u16 et u8 : mêmes recherches, la référence lit la ligne déquantifiée
+    for (HistStorage storage : {HIST_UINT16, HIST_UINT8}) {
+        LbphMatcher quantized;
+        fill_gallery(quantized);
+        quantized.set_storage(storage);
+        CHECK(quantized.storage() == storage);
+        CHECK(quantized.memory_bytes() < float_model.memory_bytes());
+        check_searches(quantized, queries);
+        for (size_t q = 0; q + 2 < queries.size(); q++) {
+            quantized.nearest(queries[q].data(), label, distance);
+            CHECK(label == (int) q * 3);
+        }
+
+        // Ajout après conversion : quantifié à la volée
+        quantized.add_histogram(queries[0].data(), 99);
+        check_searches(quantized, queries);
+    }
+
+    // Suppression : le label disparaît des recherches
+    CHECK(float_model.remove_label(0) == (size_t) SHOTS);
+    CHECK(float_model.count_label(0) == 0);
+    float_model.nearest(queries[0].data(), label, distance);
+    CHECK(label != 0);
+    CHECK(!float_model.nearest_in_label(queries[0].data(), 0, distance));
+    check_searches(float_model, queries);
+
+    // Galerie vide : label -1
+    LbphMatcher empty;
+    empty.nearest(queries[0].data(), label, distance);
+    CHECK(label == -1);
+    return TEST_RESULT();
+}
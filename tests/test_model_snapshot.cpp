@@ -0,0 +1,188 @@
+#include "model_snapshot.hpp"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "test_check.hpp"
+
+namespace fs = std::filesystem;
+
+// Position du nombre d'entrées dans l'en-tête : magic, 8 x u32, empreinte u64
+static const size_t COUNT_OFFSET = 8 + 8 * 4 + 8;
+static const uint64_t FINGERPRINT = 0x1234;
+
+static void fill_gallery(LbphMatcher& m, int rows) {
+    AlignedFloats h;
+    for (int i = 0; i < rows; i++) {
+        CHECK(m.extract(synthetic_gray(i / 2, 100u + i, 12), h));
+        m.add_histogram(h.data(), i / 2);
+    }
+}
+
+static bool same_rows(const LbphMatcher& a, const LbphMatcher& b) {
+    if (a.size() != b.size() || a.dim() != b.dim() || a.storage() != b.storage()) return false;
+    std::vector<float> x(a.dim()), y(a.dim());
+    for (size_t i = 0; i < a.size(); i++) {
+        a.copy_histogram(i, x.data());
+        b.copy_histogram(i, y.data());
+        if (a.label(i) != b.label(i) || x != y) return false;
+    }
+    return true;
+}
+
+static std::string read_file(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+static void write_file(const std::string& path, const std::string& bytes) {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out.write(bytes.data(), (std::streamsize) bytes.size());
+}
+
+// Chargement refusé, modèle laissé vide
+static void check_rejected(const std::string& path, HistStorage storage, uint64_t fingerprint) {
+    LbphMatcher m;
+    m.set_storage(storage);
+    std::string reason;
+    CHECK(!load_snapshot(path, m, fingerprint, reason));
+    CHECK(!reason.empty());
+    CHECK(m.empty());
+}
+
+int main() {
+    fs::path dir = fs::temp_directory_path() / "lbph_snapshot_test";
+    fs::remove_all(dir);
+    fs::create_directories(dir);
+    const std::string path = (dir / "model.lbph").string();
+    std::string reason;
+
+    // Aller-retour en float
+    LbphMatcher model;
+    fill_gallery(model, 12);
+    CHECK(save_snapshot(path, model, FINGERPRINT));
+    CHECK(!fs::exists(path + ".tmp"));
+    const std::string bytes = read_file(path);
+    CHECK(bytes.size() == 8 + 8 * 4 + 3 * 8 + 12 * (4 + model.dim() * 4) + 8);
+    LbphMatcher loaded;
+    CHECK(load_snapshot(path, loaded, FINGERPRINT, reason));
+    CHECK(same_rows(model, loaded));
+
+    // Aller-retour u8 ; refusé par un serveur d'un autre format
+    LbphMatcher quantized;
+    fill_gallery(quantized, 12);
+    quantized.set_storage(HIST_UINT8);
+    const std::string path8 = (dir / "model8.lbph").string();
+    CHECK(save_snapshot(path8, quantized, FINGERPRINT));
+    LbphMatcher loaded8;
+    loaded8.set_storage(HIST_UINT8);
+    CHECK(load_snapshot(path8, loaded8, FINGERPRINT, reason));
+    CHECK(same_rows(quantized, loaded8));
+    check_rejected(path8, HIST_FLOAT32, FINGERPRINT);
+    check_rejected(path8, HIST_UINT16, FINGERPRINT);
+
+    // Galerie vide
+    LbphMatcher empty;
+    CHECK(save_snapshot(path, empty, FINGERPRINT));
+    LbphMatcher loaded_empty;
+    CHECK(load_snapshot(path, loaded_empty, FINGERPRINT, reason));
+    CHECK(loaded_empty.empty());
+
+    // Absent, dossier modifié, paramètres LBP différents
+    check_rejected((dir / "absent.lbph").string(), HIST_FLOAT32, FINGERPRINT);
+    write_file(path, bytes);
+    check_rejected(path, HIST_FLOAT32, FINGERPRINT + 1);
+    LbpParams other;
+    other.uniform = true;
+    LbphMatcher uniform(other);
+    CHECK(!load_snapshot(path, uniform, FINGERPRINT, reason));
+
+    // Tronqué (en-tête, labels, histogrammes, somme de contrôle)
+    for (size_t keep : {(size_t) 0, (size_t) 20, COUNT_OFFSET + 30, bytes.size() / 2, bytes.size() - 1}) {
+        write_file(path, bytes.substr(0, keep));
+        check_rejected(path, HIST_FLOAT32, FINGERPRINT);
+    }
+    // Un octet de trop
+    write_file(path, bytes + '\0');
+    check_rejected(path, HIST_FLOAT32, FINGERPRINT);
+
+    // Un bit changé dans les histogrammes : somme de contrôle
+    std::string corrupt = bytes;
+    corrupt[bytes.size() - 100] ^= 0x04;
+    write_file(path, corrupt);
+    check_rejected(path, HIST_FLOAT32, FINGERPRINT);
+
+    // Nombre d'entrées forgé : refusé avant toute allocation
+    for (uint64_t count : {(uint64_t) 1 << 60, ~(uint64_t) 0, (uint64_t) 11, (uint64_t) 13}) {
+        std::string forged = bytes;
+        memcpy(&forged[COUNT_OFFSET], &count, sizeof(count));
+        write_file(path, forged);
+        check_rejected(path, HIST_FLOAT32, FINGERPRINT);
+    }
+
+    // Journal : ajout, suppression puis nouvel ajout du même label, en deux
+    // lots, rejoués dans l'ordre par-dessus l'instantané
+    write_file(path, bytes);
+    LbphMatcher extra;
+    fill_gallery(extra, 16);
+    std::vector<float> row12(model.dim()), row14(model.dim());
+    extra.copy_histogram(12, row12.data());
+    extra.copy_histogram(14, row14.data());
+    std::vector<JournalEdit> first = {{6, row12}, {2, std::vector<float>()}};
+    std::vector<JournalEdit> second = {{2, row14}};
+    CHECK(append_journal(path, model.dim(), FINGERPRINT, first, FINGERPRINT + 1));
+    CHECK(append_journal(path, model.dim(), FINGERPRINT, second, FINGERPRINT + 2));
+    LbphMatcher expected;
+    fill_gallery(expected, 12);
+    expected.add_histogram(row12.data(), 6);
+    expected.remove_label(2);
+    expected.add_histogram(row14.data(), 2);
+
+    size_t edits = 0;
+    LbphMatcher journaled;
+    CHECK(load_snapshot(path, journaled, FINGERPRINT + 2, reason, &edits));
+    CHECK(edits == 3);
+    CHECK(same_rows(expected, journaled));
+    // Seule l'empreinte du dernier lot vaut pour le dossier
+    check_rejected(path, HIST_FLOAT32, FINGERPRINT);
+    check_rejected(path, HIST_FLOAT32, FINGERPRINT + 1);
+
+    // Journal d'un autre instantané : pas d'ajout, ignoré au chargement
+    CHECK(!append_journal(path, model.dim(), FINGERPRINT + 7, second, FINGERPRINT + 3));
+    CHECK(!append_journal(path, model.dim() + 1, FINGERPRINT, second, FINGERPRINT + 3));
+
+    // Dernier lot incomplet (arrêt pendant l'écriture) : on s'arrête au lot
+    // précédent, dont l'empreinte n'est plus celle du dossier
+    const std::string journal = read_file(journal_path(path));
+    write_file(journal_path(path), journal.substr(0, journal.size() - 5));
+    check_rejected(path, HIST_FLOAT32, FINGERPRINT + 2);
+    CHECK(load_snapshot(path, journaled, FINGERPRINT + 1, reason, &edits));
+    CHECK(edits == 2);
+    // Un bit changé dans un enregistrement : même chose
+    std::string flipped = journal;
+    flipped[journal.size() - 300] ^= 0x10;
+    write_file(journal_path(path), flipped);
+    check_rejected(path, HIST_FLOAT32, FINGERPRINT + 2);
+
+    // Un nouvel instantané repart sans journal
+    write_file(journal_path(path), journal);
+    CHECK(save_snapshot(path, expected, FINGERPRINT + 2));
+    CHECK(!fs::exists(journal_path(path)));
+    CHECK(load_snapshot(path, journaled, FINGERPRINT + 2, reason, &edits));
+    CHECK(edits == 0);
+    CHECK(same_rows(expected, journaled));
+
+    // L'empreinte suit le contenu du dossier et le sel
+    fs::path images = dir / "images";
+    fs::create_directories(images);
+    uint64_t before = directory_fingerprint(images.string());
+    CHECK(before == directory_fingerprint(images.string()));
+    CHECK(before != directory_fingerprint(images.string(), "shard=0/2"));
+    write_file((images / "1.jpg").string(), "x");
+    CHECK(before != directory_fingerprint(images.string()));
+
+    fs::remove_all(dir);
+    return TEST_RESULT();
+}
@@ -0,0 +1,69 @@
+#include "result_cache.hpp"
+
+#include <chrono>
+#include <thread>
+#include "test_check.hpp"
+
+// Empreinte dont seuls les `bits` premiers bits sont à un
+static PHash key_with_bits(int bits) {
+    PHash h = {{0, 0, 0, 0}};
+    for (int b = 0; b < bits; b++) h.bits[b >> 6] |= (uint64_t) 1 << (b & 63);
+    return h;
+}
+
+int main() {
+    int label;
+    double distance;
+
+    // Empreinte perceptuelle : même image, même empreinte ; images distinctes, loin
+    cv::Mat face = synthetic_gray(1, 1, 0);
+    CHECK(hamming_distance(perceptual_hash(face), perceptual_hash(face.clone())) == 0);
+    CHECK(hamming_distance(perceptual_hash(face), perceptual_hash(synthetic_gray(2, 1, 0))) > 40);
+    CHECK(hamming_distance(key_with_bits(0), key_with_bits(256)) == 256);
+
+    // Réponse dans le rayon de Hamming, la plus proche l'emporte
+    ResultCache cache(4, 60000, 8);
+    cache.insert(key_with_bits(0), 1, 10.0, cache.generation());
+    cache.insert(key_with_bits(6), 2, 20.0, cache.generation());
+    CHECK(cache.lookup(key_with_bits(1), label, distance) && label == 1 && distance == 10.0);
+    CHECK(cache.lookup(key_with_bits(5), label, distance) && label == 2);
+    CHECK(cache.lookup(key_with_bits(14), label, distance) && label == 2);
+    CHECK(!cache.lookup(key_with_bits(15), label, distance));
+    CHECK(cache.hits() == 3 && cache.misses() == 1);
+
+    // Inconnus aussi (label -1)
+    cache.insert(key_with_bits(100), -1, 150.0, cache.generation());
+    CHECK(cache.lookup(key_with_bits(100), label, distance) && label == -1);
+
+    // FIFO : la plus ancienne entrée est remplacée
+    cache.insert(key_with_bits(200), 4, 1.0, cache.generation());
+    cache.insert(key_with_bits(250), 5, 1.0, cache.generation());
+    CHECK(cache.size() == 4);
+    CHECK(cache.lookup(key_with_bits(0), label, distance) && label == 2);  // label 1 évincé
+    CHECK(cache.lookup(key_with_bits(250), label, distance) && label == 5);
+
+    // clear() : vidé, et un résultat calculé avant n'est pas inséré
+    uint64_t generation = cache.generation();
+    cache.clear();
+    CHECK(cache.size() == 0);
+    cache.insert(key_with_bits(0), 1, 10.0, generation);
+    CHECK(!cache.lookup(key_with_bits(0), label, distance));
+    cache.insert(key_with_bits(0), 1, 10.0, cache.generation());
+    CHECK(cache.lookup(key_with_bits(0), label, distance));
+
+    // Expiration
+    ResultCache short_lived(4, 1, 0);
+    short_lived.insert(key_with_bits(0), 1, 10.0, short_lived.generation());
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    CHECK(!short_lived.lookup(key_with_bits(0), label, distance));
+
+    // Capacité <= 0 : désactivé, sans erreur
+    for (int capacity : {0, -1, -1000}) {
+        ResultCache disabled(capacity, 60000, 8);
+        CHECK(disabled.capacity() == 0);
+        disabled.insert(key_with_bits(0), 1, 10.0, disabled.generation());
+        CHECK(!disabled.lookup(key_with_bits(0), label, distance));
+        CHECK(disabled.size() == 0);
+    }
+    return TEST_RESULT();
+}
@@ -0,0 +1,47 @@
+#include "server_metrics.hpp"
+
+#include <cstdint>
+#include <string>
+#include "test_check.hpp"
+
+// Ligne "name " ou "name{" présente dans le texte
+static bool has_series(const std::string& text, const std::string& name) {
+    return text.find("\n" + name + " ") != std::string::npos || text.find("\n" + name + "{") != std::string::npos;
+}
+
+// Texte complet même avec des compteurs à 20 chiffres et un préfixe long
+static void test_render_complete(const std::string& prefix) {
+    ServerMetrics metrics(prefix);
+    size_t ep = metrics.add_endpoint("/identify_produit");
+    metrics.count(ep, OUTCOME_MATCH);
+    metrics.observe(STAGE_PREDICT, 0.003);
+    metrics.set_gallery_size(SIZE_MAX);
+
+    std::string text = metrics.render(SIZE_MAX, UINT64_MAX, UINT64_MAX);
+    CHECK(!text.empty() && text.back() == '\n');
+    const char* series[] = {"_requests_total", "_stage_seconds_bucket", "_stage_seconds_sum",
+                            "_stage_seconds_count", "_gallery_size", "_queue_depth",
+                            "_cache_hits_total", "_cache_misses_total"};
+    for (const char* s : series) CHECK(has_series(text, prefix + s));
+    CHECK(text.find(prefix + "_cache_misses_total " + std::to_string(UINT64_MAX) + "\n") != std::string::npos);
+    CHECK(text.find(prefix + "_queue_depth " + std::to_string(SIZE_MAX) + "\n") != std::string::npos);
+}
+
+static void test_histogram_buckets() {
+    ServerMetrics metrics("face");
+    metrics.observe(STAGE_DECODE, 0.0002);
+    metrics.observe(STAGE_DECODE, 0.2);
+    metrics.observe(STAGE_DECODE, 10.0);
+    std::string text = metrics.render(0, 0, 0);
+    CHECK(text.find("face_stage_seconds_bucket{stage=\"decode\",le=\"0.00025\"} 1\n") != std::string::npos);
+    CHECK(text.find("face_stage_seconds_bucket{stage=\"decode\",le=\"0.25\"} 2\n") != std::string::npos);
+    CHECK(text.find("face_stage_seconds_bucket{stage=\"decode\",le=\"+Inf\"} 3\n") != std::string::npos);
+    CHECK(text.find("face_stage_seconds_count{stage=\"decode\"} 3\n") != std::string::npos);
+}
+
+int main() {
+    test_render_complete("face");
+    test_render_complete("product");
+    test_histogram_buckets();
+    return TEST_RESULT();
+}